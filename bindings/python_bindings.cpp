@@ -1,10 +1,13 @@
 #include "prepare-state.hpp"
 #include "qcircuit.hpp"
 #include "qstate.hpp"
+#include "state-vector.hpp"
 #include "transpile.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <map>
+#include <sstream>
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
@@ -13,6 +16,16 @@
 
 namespace py = pybind11;
 
+std::string prepare_state_qasm(const xyz::QRState& state, double eps, bool verbose) {
+    if (state.index_to_weight.empty())
+        throw std::invalid_argument("All coefficients too small");
+
+    xyz::QCircuit circuit    = xyz::prepare_state_auto(state, verbose);
+    xyz::GateList transpiled = xyz::transpile_clifford_t(circuit.to_gate_list(), eps);
+
+    return transpiled.to_qasm2();
+}
+
 std::string prepare_state_from_array(py::array_t<double> coefficients, double eps = 1e-3, bool verbose = false) {
     py::buffer_info buf = coefficients.request();
 
@@ -30,9 +43,6 @@ std::string prepare_state_from_array(py::array_t<double> coefficients, double ep
         n_bits++;
     }
 
-    if (n_bits >= 32)
-        throw std::invalid_argument("Too many qubits (max 31)");
-
     double* ptr          = static_cast<double*>(buf.ptr);
     double  norm_squared = 0.0;
     for (size_t i = 0; i < length; i++)
@@ -41,24 +51,101 @@ std::string prepare_state_from_array(py::array_t<double> coefficients, double ep
     if (std::abs(norm_squared - 1.0) > 1e-4)
         throw std::invalid_argument("State not normalized");
 
-    std::map<uint32_t, double> index_to_weight;
+    xyz::WeightMap<double> index_to_weight;
     for (size_t i = 0; i < length; i++)
         if (std::abs(ptr[i]) >= xyz::QRState::eps)
-            index_to_weight[static_cast<uint32_t>(i)] = ptr[i];
+            index_to_weight.push_back(static_cast<xyz::index_t>(i), ptr[i]);
 
-    if (index_to_weight.empty())
-        throw std::invalid_argument("All coefficients too small");
+    return prepare_state_qasm(xyz::QRState(index_to_weight, n_bits), eps, verbose);
+}
 
-    xyz::QRState  state(index_to_weight, n_bits);
-    xyz::QCircuit circuit    = xyz::prepare_state_auto(state, verbose);
-    xyz::QCircuit decomposed = xyz::decompose_circuit(circuit);
-    xyz::QCircuit transpiled = xyz::transpile_clifford_t(decomposed, eps);
+std::string prepare_sparse_state_from_arrays(py::array_t<uint64_t> indices, py::array_t<double> coefficients,
+                                             uint32_t n_bits, double eps = 1e-3, bool verbose = false) {
+    py::buffer_info ibuf = indices.request();
+    py::buffer_info cbuf = coefficients.request();
 
-    return transpiled.to_qasm2();
+    if (ibuf.ndim != 1 || cbuf.ndim != 1 || ibuf.shape[0] != cbuf.shape[0])
+        throw std::invalid_argument("Indices and coefficients must be 1D arrays of equal length");
+
+    if (n_bits > std::min<uint32_t>(64, xyz::index_bits))
+        throw std::invalid_argument("Too many qubits for the configured index width");
+
+    uint64_t* iptr = static_cast<uint64_t*>(ibuf.ptr);
+    double*   cptr = static_cast<double*>(cbuf.ptr);
+
+    /* repeated indices add up; the norm and the eps filter apply to the merged weights */
+    std::map<xyz::index_t, double> merged;
+    for (py::ssize_t i = 0; i < ibuf.shape[0]; i++) {
+        if (n_bits < 64 && (iptr[i] >> n_bits) != 0)
+            throw std::invalid_argument("Index out of range");
+        merged[iptr[i]] += cptr[i];
+    }
+
+    double                 norm_squared = 0.0;
+    xyz::WeightMap<double> index_to_weight;
+    for (const auto& [index, weight] : merged) {
+        norm_squared += weight * weight;
+        if (std::fabs(weight) >= xyz::QRState::eps)
+            index_to_weight.push_back(index, weight);
+    }
+
+    if (std::fabs(norm_squared - 1.0) > 1e-4)
+        throw std::invalid_argument("State not normalized");
+
+    return prepare_state_qasm(xyz::QRState(index_to_weight, n_bits), eps, verbose);
+}
+
+py::array_t<double> simulate_qasm_batch(const std::string& qasm, py::array_t<double> states, uint32_t n_threads = 0) {
+    py::buffer_info buf = states.request();
+
+    if (buf.ndim != 2)
+        throw std::invalid_argument("States must be a 2D array of shape (batch, 2^n)");
+
+    size_t batch = buf.shape[0], length = buf.shape[1];
+    if (length == 0 || (length & (length - 1)) != 0)
+        throw std::invalid_argument("Length must be power of 2");
+
+    uint32_t n_bits = 0;
+    while ((size_t(1) << n_bits) < length)
+        n_bits++;
+
+    std::istringstream in(qasm);
+    xyz::QCircuit      circuit = xyz::read_qasm2(in);
+    if (circuit.num_qbits > n_bits)
+        throw std::invalid_argument("Circuit has more qubits than the states");
+
+    auto                      view = states.unchecked<2>();
+    std::vector<xyz::QRState> inputs;
+    inputs.reserve(batch);
+    for (size_t k = 0; k < batch; k++) {
+        xyz::WeightMap<double> index_to_weight;
+        for (size_t i = 0; i < length; i++)
+            if (std::abs(view(k, i)) >= xyz::QRState::eps)
+                index_to_weight.push_back(static_cast<xyz::index_t>(i), view(k, i));
+        inputs.emplace_back(index_to_weight, n_bits);
+    }
+
+    std::vector<xyz::QRState> outputs;
+    {
+        py::gil_scoped_release release;
+        outputs = xyz::simulate_circuit(circuit, inputs, n_threads);
+    }
+
+    py::array_t<double> result(buf.shape);
+    auto                out = result.mutable_unchecked<2>();
+    for (size_t k = 0; k < batch; k++) {
+        for (size_t i = 0; i < length; i++)
+            out(k, i) = 0.0;
+        outputs[k].index_to_weight.for_each([&](xyz::index_t index, double weight) { out(k, (size_t)index) = weight; });
+    }
+    return result;
 }
 
 PYBIND11_MODULE(xyz_bindings, m) {
     m.def("prepare_state_from_array", &prepare_state_from_array, py::arg("coefficients"), py::arg("eps") = 1e-3,
           py::arg("verbose") = false);
+    m.def("prepare_sparse_state_from_arrays", &prepare_sparse_state_from_arrays, py::arg("indices"),
+          py::arg("coefficients"), py::arg("n_bits"), py::arg("eps") = 1e-3, py::arg("verbose") = false);
+    m.def("simulate_qasm_batch", &simulate_qasm_batch, py::arg("qasm"), py::arg("states"), py::arg("n_threads") = 0);
     m.attr("__version__") = "0.1.0";
 }
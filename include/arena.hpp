@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+namespace xyz {
+
+inline std::pmr::memory_resource*& current_state_resource() {
+    thread_local std::pmr::memory_resource* resource = nullptr;
+    return resource;
+}
+
+inline std::pmr::memory_resource* state_resource() {
+    std::pmr::memory_resource* resource = current_state_resource();
+    return resource ? resource : std::pmr::get_default_resource();
+}
+
+inline std::pmr::memory_resource* gate_resource() {
+    static auto* pool = new std::pmr::synchronized_pool_resource();
+    return pool;
+}
+
+template <typename G, typename... Args> std::shared_ptr<G> make_gate(Args&&... args) {
+    return std::allocate_shared<G>(std::pmr::polymorphic_allocator<G>(gate_resource()), std::forward<Args>(args)...);
+}
+
+/* states created on this thread inside the scope must not outlive it */
+class ArenaScope {
+  public:
+    explicit ArenaScope(std::size_t initial_size = 1 << 16)
+        : previous(current_state_resource()), arena(initial_size, state_resource()), pool(&arena) {
+        current_state_resource() = &pool;
+    };
+    ~ArenaScope() { current_state_resource() = previous; };
+    ArenaScope(const ArenaScope&)            = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+  private:
+    std::pmr::memory_resource*             previous;
+    std::pmr::monotonic_buffer_resource    arena;
+    std::pmr::unsynchronized_pool_resource pool;
+};
+
+} // namespace xyz
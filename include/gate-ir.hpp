@@ -0,0 +1,99 @@
+#pragma once
+
+#include "qstate.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace xyz {
+
+class QGate;
+
+enum class GateKind : uint8_t { X, CX, CCX, H, Z, T, Tdg, S, Sdg, RY, CRY, MCRY, MCMY, QROM_MCRY, Unitary };
+
+/* flat gate record: qbits[0] is the target, qbits[1..2] the inline controls of CX/CRY/CCX;
+ * MCRY/MCMY/QROM_MCRY keep their controls and angles in the side tables of the owning GateList;
+ * Unitary is a fused single-qubit gate described only by coef and has no QGate counterpart */
+struct GateOp {
+    GateKind                kind;
+    bool                    phase        = true;
+    uint8_t                 n_ctrls      = 0;
+    std::array<uint32_t, 3> qbits        = {0, 0, 0};
+    uint32_t                ctrl_offset  = 0;
+    uint32_t                param_offset = 0;
+    uint32_t                n_params     = 0;
+    double                  theta        = 0.0;
+    std::array<double, 4>   coef         = {1.0, 0.0, 0.0, 1.0};
+    index_t                 ctrl_mask    = 0;
+    index_t                 ctrl_value   = 0;
+
+    uint32_t target() const { return qbits[0]; };
+};
+
+class GateList {
+  public:
+    uint32_t              num_qbits = 0;
+    std::vector<GateOp>   ops;
+    std::vector<uint32_t> ctrls;
+    std::vector<bool>     phases;
+    std::vector<double>   params;
+
+    GateList() = default;
+    GateList(uint32_t num_qbits) : num_qbits(num_qbits) {};
+    void        add(GateKind kind, uint32_t target, double theta = 0.0);
+    void        add(GateKind kind, uint32_t ctrl, bool phase, uint32_t target, double theta = 0.0);
+    void        add_ccx(uint32_t ctrl1, uint32_t ctrl2, uint32_t target);
+    void        add_unitary(uint32_t target, const std::array<double, 4>& coef);
+    void        add_mcry(const std::vector<uint32_t>& ctrls, const std::vector<bool>& phases, double theta,
+                         uint32_t target);
+    void        add_multiplexed(GateKind kind, const std::vector<uint32_t>& ctrls, const std::vector<bool>& phases,
+                                const std::vector<double>& table, uint32_t target, double eps = 0.0);
+    void        append(const GateList& other, const GateOp& op);
+    std::size_t size() const { return ops.size(); };
+
+    std::vector<uint32_t>  ctrls_of(const GateOp& op) const;
+    std::vector<bool>      phases_of(const GateOp& op) const;
+    std::vector<double>    params_of(const GateOp& op) const;
+    double                 eps_of(const GateOp& op) const { return params[op.param_offset + op.n_params]; };
+    uint64_t               hash_of(const GateOp& op) const;
+    std::string            to_string(const GateOp& op) const;
+    std::shared_ptr<QGate> to_gate(const GateOp& op) const;
+    std::string            to_qasm2() const;
+    void                   apply(const GateOp& op, QRState& state, const bool reverse = false) const;
+    void                   apply(const GateOp& op, QState& state, const bool reverse = false) const;
+};
+
+/* Auto runs the dense StateVector engine when prefer_dense expects the state to fill up */
+enum class SimEngine : uint8_t { Auto, Sparse, Dense };
+
+struct sim_params {
+    bool      fuse           = false;
+    SimEngine engine         = SimEngine::Auto;
+    uint32_t  n_threads      = 0;  // dense engine threads, 0 uses the shared pool
+    uint32_t  dense_max_bits = 26; // Auto never allocates more than 2^dense_max_bits amplitudes
+    uint32_t  permute_run    = 3;  // sparse runs of this many X/CX/CCX are relabeled in one pass, 0 never
+    uint32_t  phase_run      = 2;  // complex runs of this many diagonal and X/CX gates are one phase pass, 0 never
+    sim_params()             = default;
+    sim_params(bool fuse, SimEngine engine = SimEngine::Auto, uint32_t n_threads = 0)
+        : fuse(fuse), engine(engine), n_threads(n_threads) {}
+};
+
+struct sim_stats {
+    uint32_t  num_gates  = 0;
+    uint32_t  num_passes = 0;
+    SimEngine engine     = SimEngine::Sparse;
+    double   fusion_ratio() const { return num_passes ? (double)num_gates / num_passes : 1.0; };
+};
+
+GateList decompose(const GateList& list);
+GateList fuse(const GateList& list);
+QRState  simulate(const GateList& list, const QRState& state, bool verbose = false);
+QRState  simulate(const GateList& list, const QRState& state, const sim_params& params, sim_stats* stats = nullptr);
+QState   simulate(const GateList& list, const QState& state, const sim_params& params = sim_params(),
+                  sim_stats* stats = nullptr);
+void     write_qasm2(const GateList& list, const std::string& filename);
+
+} // namespace xyz
@@ -0,0 +1,374 @@
+#pragma once
+
+#include "qstate.hpp"
+#include "thread-pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+namespace xyz {
+namespace kernels {
+template <typename T> uint64_t entry_repr(index_t index, const T& weight) {
+    if constexpr (std::is_same_v<T, double>)
+        return QRState::repr_term(index, weight);
+    else
+        return 0;
+}
+
+template <typename T>
+uint64_t pair_repr(index_t index0, index_t bit, const T& w0, const T& w1, bool has0, bool has1) {
+    return (has0 ? entry_repr(index0, w0) : 0) ^ (has1 ? entry_repr(index0 | bit, w1) : 0);
+}
+
+/* pair p of a dense vector: p with a zero inserted at the target bit */
+inline std::size_t dense_pair(std::size_t p, index_t bit) {
+    const std::size_t low = (std::size_t)bit - 1;
+    return ((p & ~low) << 1) | (p & low);
+}
+
+/* even cuts of n independent items for the shared pool; empty (one slice) below QRState::parallel_min_size */
+inline std::vector<std::size_t> even_slices(std::size_t n) {
+    const std::size_t parts = n >= QRState::parallel_min_size ? shared_pool().size() : 1;
+    if (parts == 1)
+        return {};
+    std::vector<std::size_t> bounds(parts + 1);
+    for (std::size_t k = 0; k <= parts; k++)
+        bounds[k] = k * n / parts;
+    return bounds;
+}
+
+/* even cuts of n_pairs dense pairs, sized by the amplitudes they cover */
+inline std::vector<std::size_t> dense_slices(std::size_t n_pairs) {
+    std::vector<std::size_t> bounds = even_slices(2 * n_pairs);
+    for (auto& bound : bounds)
+        bound /= 2;
+    return bounds;
+}
+
+/* cuts of a sorted entry list only where index >> (target + 1) changes, so both halves of every pair
+ * land in the same slice; empty (one slice) below QRState::parallel_min_size */
+template <typename Entries> std::vector<std::size_t> sparse_slices(const Entries& entries, uint32_t target) {
+    const std::size_t n     = entries.size();
+    const std::size_t parts = n >= QRState::parallel_min_size ? shared_pool().size() : 1;
+    if (parts == 1)
+        return {};
+    std::vector<std::size_t> bounds{0};
+    for (std::size_t k = 1; k < parts; k++) {
+        std::size_t cut = std::max(bounds.back(), k * n / parts);
+        while (cut > 0 && cut < n && (entries[cut].first >> target >> 1) == (entries[cut - 1].first >> target >> 1))
+            cut++;
+        if (cut > bounds.back() && cut < n)
+            bounds.push_back(cut);
+    }
+    bounds.push_back(n);
+    return bounds;
+}
+
+/* pass(k, begin, end, hash) over every slice of [0, n) on the shared pool; the slices write disjoint
+ * ranges, their hash deltas are XOR-combined and their returned counts summed */
+template <typename Pass>
+std::size_t run_slices(std::size_t n, const std::vector<std::size_t>& bounds, uint64_t* hash, Pass&& pass) {
+    if (bounds.size() <= 2)
+        return pass(0u, std::size_t(0), n, hash);
+    const uint32_t parts = (uint32_t)bounds.size() - 1;
+    std::vector<std::size_t> sums(parts, 0);
+    std::vector<uint64_t>    hashes(parts, 0);
+    shared_pool().run(parts, [&](uint32_t k) {
+        sums[k] = pass(k, bounds[k], bounds[k + 1], hash ? &hashes[k] : nullptr);
+    });
+    std::size_t sum = 0;
+    for (uint32_t k = 0; k < parts; k++) {
+        sum += sums[k];
+        if (hash)
+            *hash ^= hashes[k];
+    }
+    return sum;
+}
+
+template <typename T, typename Fn> void transform_pairs(WeightMap<T>& map, uint32_t target, Fn&& fn, uint64_t* hash) {
+    using entry       = typename WeightMap<T>::value_type;
+    const index_t bit = index_t(1) << target;
+
+    auto update = [&](index_t index0, T& w0, T& w1, bool& has0, bool& has1, uint64_t* h) {
+        T    o0 = w0, o1 = w1;
+        bool g0 = has0, g1 = has1;
+        if ((fn(index0, w0, w1, has0, has1) || has0 != g0 || has1 != g1) && h)
+            *h ^= pair_repr(index0, bit, o0, o1, g0, g1) ^ pair_repr(index0, bit, w0, w1, has0, has1);
+    };
+    if (map.is_dense()) {
+        auto& o = map.edit();
+        auto& d = o.dense;
+        /* returns the change of the nonzero count, modulo 2^64 */
+        auto pass = [&](uint32_t, std::size_t begin, std::size_t end, uint64_t* h) {
+            std::size_t delta = 0;
+            for (std::size_t p = begin; p < end; p++) {
+                const std::size_t i    = dense_pair(p, bit);
+                bool              has0 = d[i] != T(0), has1 = d[i + bit] != T(0);
+                if (!has0 && !has1)
+                    continue;
+                delta -= has0 + has1;
+                update((index_t)i, d[i], d[i + bit], has0, has1, h);
+                if (!has0)
+                    d[i] = T(0);
+                if (!has1)
+                    d[i + bit] = T(0);
+                delta += (d[i] != T(0)) + (d[i + bit] != T(0));
+            }
+            return delta;
+        };
+        o.dense_size += run_slices(d.size() / 2, dense_slices(d.size() / 2), hash, pass);
+        return;
+    }
+    const auto&                    in       = map.entries();
+    const std::vector<std::size_t> bounds   = sparse_slices(in, target);
+    auto                           by_index = [](const entry& a, const entry& b) { return a.first < b.first; };
+    auto split = [&](std::size_t begin, std::size_t end, uint64_t* h, std::vector<entry>& out0,
+                     std::vector<entry>& out1) {
+        out0.clear();
+        out1.clear();
+        for_each_pair_in(in.data() + begin, end - begin, bit, [&](index_t index0, const T* weight0, const T* weight1) {
+            T    w0 = weight0 ? *weight0 : T(0), w1 = weight1 ? *weight1 : T(0);
+            bool has0 = weight0 != nullptr, has1 = weight1 != nullptr;
+            update(index0, w0, w1, has0, has1, h);
+            if (has0)
+                out0.emplace_back(index0, w0);
+            if (has1)
+                out1.emplace_back(index0 | bit, w1);
+        });
+    };
+    if (bounds.size() <= 2) {
+        thread_local std::vector<entry> out0, out1;
+        split(0, in.size(), hash, out0, out1);
+        auto& entries = map.rewrite().entries;
+        entries.resize(out0.size() + out1.size());
+        std::merge(out0.begin(), out0.end(), out1.begin(), out1.end(), entries.begin(), by_index);
+        return;
+    }
+    std::vector<std::vector<entry>> outs(bounds.size() - 1);
+    run_slices(in.size(), bounds, hash, [&](uint32_t k, std::size_t begin, std::size_t end, uint64_t* h) {
+        std::vector<entry> out0, out1;
+        split(begin, end, h, out0, out1);
+        outs[k].resize(out0.size() + out1.size());
+        std::merge(out0.begin(), out0.end(), out1.begin(), out1.end(), outs[k].begin(), by_index);
+        return std::size_t(0);
+    });
+    std::vector<std::size_t> offsets(outs.size() + 1, 0);
+    for (std::size_t k = 0; k < outs.size(); k++)
+        offsets[k + 1] = offsets[k] + outs[k].size();
+    auto& entries = map.rewrite().entries;
+    entries.resize(offsets.back());
+    run_slices(entries.size(), bounds, nullptr, [&](uint32_t k, std::size_t, std::size_t, uint64_t*) {
+        std::copy(outs[k].begin(), outs[k].end(), entries.begin() + offsets[k]);
+        return std::size_t(0);
+    });
+}
+
+template <typename T, typename C, typename Pred>
+void rotate_pairs(WeightMap<T>& map, uint32_t target, const C& c00, const C& c01, const C& c10, const C& c11,
+                  Pred&& active, uint64_t* hash = nullptr) {
+    transform_pairs(
+        map, target,
+        [&](index_t index0, T& w0, T& w1, bool& has0, bool& has1) {
+            bool on = active(index0);
+            if (on) {
+                T n0 = c00 * w0 + c10 * w1;
+                T n1 = c01 * w0 + c11 * w1;
+                w0   = n0;
+                w1   = n1;
+            }
+            has0 = (has0 || on) && std::abs(w0) >= QRState::eps;
+            has1 = (has1 || on) && std::abs(w1) >= QRState::eps;
+            return on;
+        },
+        hash);
+}
+
+template <typename T, typename Pred>
+void flip_pairs(WeightMap<T>& map, uint32_t target, Pred&& active, uint64_t* hash = nullptr) {
+    using entry       = typename WeightMap<T>::value_type;
+    const index_t bit = index_t(1) << target;
+    if (map.is_dense()) {
+        auto& d = map.edit().dense;
+        auto  pass = [&](uint32_t, std::size_t begin, std::size_t end, uint64_t* h) {
+            for (std::size_t p = begin; p < end; p++) {
+                const std::size_t i    = dense_pair(p, bit);
+                bool              has0 = d[i] != T(0), has1 = d[i + bit] != T(0);
+                if ((!has0 && !has1) || !active((index_t)i))
+                    continue;
+                if (h)
+                    *h ^= pair_repr((index_t)i, bit, d[i], d[i + bit], has0, has1) ^
+                          pair_repr((index_t)i, bit, d[i + bit], d[i], has1, has0);
+                std::swap(d[i], d[i + bit]);
+            }
+            return std::size_t(0);
+        };
+        run_slices(d.size() / 2, dense_slices(d.size() / 2), hash, pass);
+        return;
+    }
+    auto& entries = map.edit().entries;
+    auto  pass    = [&](uint32_t, std::size_t from, std::size_t to, uint64_t* h) {
+        thread_local std::vector<entry> run;
+        for (std::size_t begin = from, end = from; begin < to; begin = end) {
+            const index_t high = entries[begin].first >> target >> 1;
+            std::size_t   mid  = begin;
+            bool          any  = false;
+            for (end = begin; end < to && (entries[end].first >> target >> 1) == high; end++) {
+                auto& [index, weight] = entries[end];
+                mid += !(index & bit);
+                if (!active(index & ~bit))
+                    continue;
+                if (h)
+                    *h ^= entry_repr(index, weight) ^ entry_repr(index ^ bit, weight);
+                index ^= bit;
+                any = true;
+            }
+            if (!any)
+                continue;
+            run.assign(entries.begin() + begin, entries.begin() + end);
+            const std::size_t n0 = mid - begin, n = end - begin;
+            std::size_t       k  = begin;
+            for (index_t half : {index_t(0), bit}) {
+                std::size_t i = 0, j = n0;
+                while (true) {
+                    while (i < n0 && (run[i].first & bit) != half)
+                        i++;
+                    while (j < n && (run[j].first & bit) != half)
+                        j++;
+                    if (i == n0 && j == n)
+                        break;
+                    if (j == n || (i < n0 && run[i].first < run[j].first))
+                        entries[k++] = run[i++];
+                    else
+                        entries[k++] = run[j++];
+                }
+            }
+        }
+        return std::size_t(0);
+    };
+    run_slices(entries.size(), sparse_slices(entries, target), hash, pass);
+}
+
+struct Unscaled {
+    template <typename T> const T& operator()(index_t, const T& weight) const { return weight; };
+};
+
+/* moves every amplitude from index to perm(index), multiplied by scale(index, weight), in one pass; perm
+ * must be a bijection of the basis */
+template <typename T, typename Perm, typename Scale = Unscaled>
+void relabel(WeightMap<T>& map, Perm&& perm, uint64_t* hash = nullptr, const Scale& scale = Scale()) {
+    if (map.is_dense()) {
+        auto&               d = map.edit().dense;
+        std::pmr::vector<T> out(d.size(), T(0), d.get_allocator());
+        auto                pass = [&](uint32_t, std::size_t begin, std::size_t end, uint64_t* h) {
+            for (std::size_t i = begin; i < end; i++) {
+                if (d[i] == T(0))
+                    continue;
+                const index_t j     = perm((index_t)i);
+                out[(std::size_t)j] = scale((index_t)i, d[i]);
+                if (h)
+                    *h ^= entry_repr((index_t)i, d[i]) ^ entry_repr(j, out[(std::size_t)j]);
+            }
+            return std::size_t(0);
+        };
+        run_slices(d.size(), even_slices(d.size()), hash, pass);
+        d.swap(out);
+        return;
+    }
+    auto& entries = map.edit().entries;
+    auto  pass    = [&](uint32_t, std::size_t begin, std::size_t end, uint64_t* h) {
+        for (std::size_t i = begin; i < end; i++) {
+            auto& [index, weight] = entries[i];
+            const index_t j       = perm(index);
+            const T       w       = scale(index, weight);
+            if (h)
+                *h ^= entry_repr(index, weight) ^ entry_repr(j, w);
+            index  = j;
+            weight = w;
+        }
+        return std::size_t(0);
+    };
+    run_slices(entries.size(), even_slices(entries.size()), hash, pass);
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+}
+
+/* multiplies every amplitude by scale(index, weight) in place */
+template <typename T, typename Scale> void rescale(WeightMap<T>& map, const Scale& scale) {
+    if (map.is_dense()) {
+        auto& d    = map.edit().dense;
+        auto  pass = [&](uint32_t, std::size_t begin, std::size_t end, uint64_t*) {
+            for (std::size_t i = begin; i < end; i++)
+                if (d[i] != T(0))
+                    d[i] = scale((index_t)i, d[i]);
+            return std::size_t(0);
+        };
+        run_slices(d.size(), even_slices(d.size()), nullptr, pass);
+        return;
+    }
+    auto& entries = map.edit().entries;
+    auto  pass    = [&](uint32_t, std::size_t begin, std::size_t end, uint64_t*) {
+        for (std::size_t i = begin; i < end; i++)
+            entries[i].second = scale(entries[i].first, entries[i].second);
+        return std::size_t(0);
+    };
+    run_slices(entries.size(), even_slices(entries.size()), nullptr, pass);
+}
+
+constexpr auto always = [](index_t) { return true; };
+
+template <typename Kernel> void apply_kernel(QRState& state, Kernel&& kernel) {
+    std::optional<uint64_t> hash = state.cached_repr();
+    kernel(state.index_to_weight, hash ? &*hash : nullptr);
+    state.set_repr(hash);
+    state.update_storage();
+}
+
+template <typename Kernel> void apply_kernel(QState& state, Kernel&& kernel) {
+    kernel(state.index_to_weight, nullptr);
+}
+
+/* 2x2 rotation on pairs whose control bits match; reverse swaps the off-diagonal coefficients */
+template <typename State, typename C>
+void rotate_masked(State& state, uint32_t target, const std::array<C, 4>& c, index_t mask, index_t value,
+                   const bool reverse = false) {
+    auto active = [&](index_t index) { return (index & mask) == value; };
+    apply_kernel(state, [&](auto& map, uint64_t* hash) {
+        rotate_pairs(map, target, c[0], reverse ? c[2] : c[1], reverse ? c[1] : c[2], c[3], active, hash);
+    });
+}
+
+/* one pass of a uniformly controlled RY: each pair is rotated by angles[gather(ctrls)] */
+template <typename State>
+void rotate_multiplexed(State& state, const std::vector<uint32_t>& ctrls, uint32_t target,
+                        const std::vector<double>& angles, const bool reverse = false) {
+    const double        sign = reverse ? -1.0 : 1.0;
+    std::vector<double> c(angles.size()), s(angles.size());
+    for (uint32_t i = 0; i < angles.size(); i++) {
+        c[i] = std::cos(angles[i] / 2);
+        s[i] = sign * std::sin(angles[i] / 2);
+    }
+    apply_kernel(state, [&](auto& map, uint64_t* hash) {
+        transform_pairs(
+            map, target,
+            [&](index_t index0, auto& w0, auto& w1, bool& has0, bool& has1) {
+                const uint32_t i  = gather_bits(index0, ctrls);
+                const bool     on = i < angles.size();
+                if (on) {
+                    auto n0 = c[i] * w0 - s[i] * w1;
+                    auto n1 = s[i] * w0 + c[i] * w1;
+                    w0      = n0;
+                    w1      = n1;
+                }
+                has0 = (has0 || on) && std::abs(w0) >= QRState::eps;
+                has1 = (has1 || on) && std::abs(w1) >= QRState::eps;
+                return on;
+            },
+            hash);
+    });
+}
+} // namespace kernels
+} // namespace xyz
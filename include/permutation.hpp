@@ -0,0 +1,56 @@
+#pragma once
+
+#include "gate-ir.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace xyz {
+
+inline bool is_permutation(GateKind kind) {
+    return kind == GateKind::X || kind == GateKind::CX || kind == GateKind::CCX;
+}
+
+/* end of the maximal run of X/CX/CCX gates starting at ops[begin] */
+std::size_t permutation_run_end(const GateList& list, std::size_t begin);
+
+/* a run of X/CX/CCX gates compiled into one relabeling of the basis. Without CCX the run is affine over
+ * GF(2), x -> Ax ^ b, and is evaluated a byte of x at a time through tables of the columns of A; with CCX
+ * the controlled flips are replayed on the index */
+class IndexPermutation {
+  public:
+    IndexPermutation(const GateList& list, std::size_t begin, std::size_t end);
+
+    bool        is_affine() const { return !tables.empty(); };
+    std::size_t num_gates() const { return n_gates; };
+
+    index_t operator()(index_t index) const {
+        if (is_affine()) {
+            index_t out = (index & ~low) ^ shift;
+            for (std::size_t b = 0; b < tables.size(); b++)
+                out ^= tables[b][(std::size_t)(index >> (8 * b)) & 0xff];
+            return out;
+        }
+        for (const auto& flip : flips)
+            if ((index & flip.ctrl_mask) == flip.ctrl_value)
+                index ^= flip.bit;
+        return index;
+    };
+
+  private:
+    struct Flip {
+        index_t bit;
+        index_t ctrl_mask;
+        index_t ctrl_value;
+    };
+
+    std::size_t                           n_gates = 0;
+    std::vector<Flip>                     flips;
+    index_t                               low   = 0;
+    index_t                               shift = 0;
+    std::vector<std::array<index_t, 256>> tables;
+};
+
+} // namespace xyz
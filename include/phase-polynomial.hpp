@@ -0,0 +1,56 @@
+#pragma once
+
+#include "gate-ir.hpp"
+#include "permutation.hpp"
+
+#include <array>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace xyz {
+
+/* eighth turns of the |1> phase of an uncontrolled diagonal gate, or nullopt if op is not one */
+std::optional<uint32_t> phase_eighths(const GateOp& op);
+
+/* end of the maximal run of diagonal phase gates and X/CX gates starting at ops[begin] */
+std::size_t phase_run_end(const GateList& list, std::size_t begin);
+
+/* a run of Z/S/Sdg/T/Tdg and X/CX gates in phase-polynomial form: each diagonal gate adds eighth turns
+ * on the parity of input bits its qubit holds at that point, so the run is one phase per basis state,
+ * taken at the input index, followed by the affine relabeling of its X/CX gates */
+class PhasePolynomial {
+  public:
+    PhasePolynomial(const GateList& list, std::size_t begin, std::size_t end);
+
+    std::size_t             num_gates() const { return n_gates; };
+    std::size_t             num_terms() const { return terms.size(); };
+    bool                    permutes() const { return perm.has_value(); };
+    const IndexPermutation& permutation() const { return *perm; };
+
+    std::complex<double> operator()(index_t index) const {
+        uint32_t eighths = offset;
+        for (const auto& [mask, k] : terms)
+            eighths += k * parity(index & mask);
+        return turns[eighths & 7];
+    };
+
+  private:
+    static uint32_t parity(index_t x) {
+        if constexpr (sizeof(index_t) > 8)
+            return __builtin_parityll((uint64_t)x ^ (uint64_t)(x >> 32 >> 32));
+        else
+            return __builtin_parityll((uint64_t)x);
+    };
+
+    std::size_t                               n_gates = 0;
+    uint32_t                                  offset  = 0;
+    std::vector<std::pair<index_t, uint32_t>> terms;
+    std::array<std::complex<double>, 8>       turns;
+    std::optional<IndexPermutation>           perm;
+};
+
+} // namespace xyz
@@ -2,18 +2,58 @@
 
 #include "qcircuit.hpp"
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <vector>
 
 namespace xyz {
 
+/* lower bound on the CNOTs still needed to reach the ground state; A* stays optimal when it is consistent,
+ * i.e. no move lowers it by more than the move's CNOT count. It must be thread-safe when n_threads != 1 */
+using bfs_heuristic = std::function<uint32_t(const QRState&)>;
+
 struct bfs_params {
-    uint32_t max_depth     = 12;
-    uint32_t max_neighbors = 100;
-    bfs_params()           = default;
+    uint32_t      max_depth     = 12;
+    uint32_t      max_neighbors = 100;
+    bfs_heuristic heuristic; // empty runs the uniform-cost search, otherwise A* on f = g + h
+    bool          perimeter = false; // finish states within 1 CNOT of a product state in closed form
+    bool          canonical = false; // search canonical_state representatives instead of states
+    uint32_t      n_threads = 1;     // 0 uses the shared pool; the result does not depend on it
+    bfs_params()            = default;
     bfs_params(uint32_t max_depth, uint32_t max_neighbors) : max_depth(max_depth), max_neighbors(max_neighbors) {}
 };
 
+struct bfs_stats {
+    uint64_t num_expanded  = 0;
+    uint64_t num_generated = 0;
+    uint32_t cnot_cost     = 0;
+    /* the circuit has the fewest CNOTs among those of enumerated moves: a solution was found, the heuristic
+     * is consistent, no expansion dropped moves to max_neighbors and no node was left unexpanded at
+     * max_depth, since a state closed at the cap also blocks shallower paths of the same cost */
+    bool optimal = false;
+};
+
+/* ceil(e / 2) for the e qubits that do not factor out of the state: each must be touched by a two-qubit
+ * gate, which costs at least one CNOT and touches two qubits; single-qubit moves leave e unchanged */
+uint32_t entangled_qubit_bound(const QRState& state);
+
+/* a relabeling of a state that keeps its CNOT cost: flip the qubits in flips, move qubit q to qubits[q]
+ * (empty keeps every qubit in place) and negate every weight if negate is set */
+struct state_symmetry {
+    std::vector<uint32_t> qubits;
+    index_t               flips  = 0;
+    bool                  negate = false;
+    QRState               operator()(const QRState& state) const;
+    /* this symmetry followed by next */
+    state_symmetry then(const state_symmetry& next, uint32_t n_bits) const;
+};
+
+/* the representative of the states equal up to a state_symmetry, and the symmetry taking state to it.
+ * Qubits are ordered by refined flip-invariant signatures and remaining ties go to the smallest relabeled
+ * state; past a fixed number of tied orderings equivalent states may get different representatives */
+QRState canonical_state(const QRState& state, state_symmetry* symmetry = nullptr);
+
 struct ReductionResult {
     QRState                             state;
     std::vector<std::shared_ptr<QGate>> gates;
@@ -1,14 +1,17 @@
 #pragma once
 
+#include "gate-ir.hpp"
 #include "qgate.hpp"
 #include "qstate.hpp"
 
+#include <istream>
 #include <memory>
 #include <vector>
 
 namespace xyz {
 
 struct bfs_params;
+struct bfs_stats;
 
 class QCircuit {
   public:
@@ -18,17 +21,20 @@ class QCircuit {
   public:
     QCircuit() = default;
     QCircuit(uint32_t num_qbits) : num_qbits(num_qbits) {};
+    explicit QCircuit(const GateList& list);
     void        add_gate(std::shared_ptr<QGate> gate);
     void        reverse();
     uint32_t    num_cnots() const;
     uint32_t    lev_cnots() const;
     std::string to_qasm2() const;
+    GateList    to_gate_list() const;
 };
 
 QCircuit decompose_circuit(const QCircuit& circuit);
 
 QCircuit prepare_state(const QRState& state, bool verbose = false);
-bool     prepare_state_bfs(const QRState& state, QCircuit& circuit, const bfs_params& params, bool verbose = false);
+bool     prepare_state_bfs(const QRState& state, QCircuit& circuit, const bfs_params& params, bool verbose = false,
+                           bfs_stats* stats = nullptr);
 QCircuit prepare_ghz(uint32_t n, bool log_depth = false);
 QCircuit prepare_w(uint32_t n, bool log_depth = false, bool cnot_opt = false);
 QCircuit prepare_dicke_state(int n, int k);
@@ -37,9 +43,17 @@ QCircuit resyn(const QCircuit& circuit, bool verbose = false);
 
 void     write_qasm2(const QCircuit& circuit, const std::string& filename);
 QCircuit read_qasm2(const std::string& filename, bool verbose = false);
+QCircuit read_qasm2(std::istream& in, bool verbose = false);
 
 QRState simulate_circuit(const QCircuit& circuit, const QRState& state, bool verbose = false);
+QRState simulate_circuit(const QCircuit& circuit, const QRState& state, const sim_params& params,
+                         sim_stats* stats = nullptr);
+QState  simulate_circuit(const QCircuit& circuit, const QState& state, const sim_params& params = sim_params(),
+                         sim_stats* stats = nullptr);
+std::vector<QRState> simulate_circuit(const QCircuit& circuit, const std::vector<QRState>& states,
+                                      uint32_t n_threads = 0);
 
 QCircuit transpile_clifford_t(const QCircuit& in, double eps);
+GateList transpile_clifford_t(const GateList& in, double eps);
 
 } // namespace xyz
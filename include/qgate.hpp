@@ -1,5 +1,6 @@
 #pragma once
 
+#include "gate-ir.hpp"
 #include "qstate.hpp"
 
 #include <array>
@@ -23,9 +24,16 @@ class QGate {
     uint32_t target;
     QGate() = default;
     QGate(uint32_t target) : target(target) {};
-    virtual QRState     operator()(const QRState& state, const bool reverse = false) const = 0;
-    virtual uint32_t    num_cnots() const                                                  = 0;
-    virtual std::string to_string() const                                                  = 0;
+    QRState operator()(const QRState& state, const bool reverse = false) const {
+        QRState result = state;
+        apply(result, reverse);
+        return result;
+    };
+    QState              operator()(const QState& state, const bool reverse = false) const;
+    virtual void        apply(QRState& state, const bool reverse = false) const = 0;
+    virtual void        lower(GateList& list) const                             = 0;
+    virtual uint32_t    num_cnots() const                                       = 0;
+    virtual std::string to_string() const                                       = 0;
 
     friend std::ostream& operator<<(std::ostream& os, const QGate& obj) {
         os << obj.to_string();
@@ -55,7 +63,7 @@ class RU2 {
         c10 = {_c10, _c01};
         c11 = {_c11, _c11};
     };
-    QRState operator()(const QRState& state, uint32_t target, const bool reverse = false) const;
+    void rotate(QRState& state, uint32_t target, const bool reverse = false) const;
 };
 
 class U2 {
@@ -71,17 +79,16 @@ class U2 {
         c10 = {_c10, std::conj(_c01)};
         c11 = {_c11, std::conj(_c11)};
     };
-    QRState operator()(const QRState& state, uint32_t target, const bool reverse = false) const;
-    QState  operator()(const QState& state, uint32_t target, const bool reverse = false) const;
+    void   rotate(QRState& state, uint32_t target, const bool reverse = false) const;
+    QState operator()(const QState& state, uint32_t target, const bool reverse = false) const;
 };
 
 class RY : public QGate, public Rotation, public RU2 {
   public:
     RY(uint32_t target, double theta)
         : Rotation(theta), QGate(target), RU2(cos(theta / 2), sin(theta / 2), -sin(theta / 2), cos(theta / 2)) {};
-    QRState operator()(const QRState& state, const bool reverse = false) const override {
-        return RU2::operator()(state, target, reverse);
-    };
+    void apply(QRState& state, const bool reverse = false) const override { RU2::rotate(state, target, reverse); };
+    void lower(GateList& list) const override { list.add(GateKind::RY, target, theta); };
     uint32_t    num_cnots() const override { return 0; };
     std::string to_string() const override {
         return "ry(" + std::to_string(theta) + ") q[" + std::to_string(target) + "]";
@@ -91,7 +98,8 @@ class RY : public QGate, public Rotation, public RU2 {
 class X : public QGate {
   public:
     using QGate::QGate;
-    QRState     operator()(const QRState& state, const bool reverse = false) const override;
+    void        apply(QRState& state, const bool reverse = false) const override;
+    void        lower(GateList& list) const override { list.add(GateKind::X, target); };
     uint32_t    num_cnots() const override { return 0; };
     std::string to_string() const override { return "x q[" + std::to_string(target) + "]"; };
 };
@@ -102,9 +110,8 @@ class H : public QGate, public RU2 {
     H(uint32_t target)
         : QGate(target),
           RU2(constants::sqrt2_inv, constants::sqrt2_inv, constants::sqrt2_inv, -constants::sqrt2_inv) {};
-    QRState operator()(const QRState& state, const bool reverse = false) const override {
-        return RU2::operator()(state, target, reverse);
-    };
+    void apply(QRState& state, const bool reverse = false) const override { RU2::rotate(state, target, reverse); };
+    void lower(GateList& list) const override { list.add(GateKind::H, target); };
     uint32_t    num_cnots() const override { return 0; };
     std::string to_string() const override { return "h q[" + std::to_string(target) + "]"; };
 };
@@ -112,13 +119,10 @@ class H : public QGate, public RU2 {
 class T : public QGate, public U2 {
   public:
     using QGate::QGate;
+    using QGate::operator();
     T(uint32_t target) : QGate(target), U2(1, 0, 0, std::exp(1i * M_PI / 4.0)) {};
-    QRState operator()(const QRState& state, const bool reverse = false) const override {
-        return U2::operator()(state, target, reverse);
-    };
-    QState operator()(const QState& state, const bool reverse = false) const {
-        return U2::operator()(state, target, reverse);
-    };
+    void apply(QRState& state, const bool reverse = false) const override { U2::rotate(state, target, reverse); };
+    void lower(GateList& list) const override { list.add(GateKind::T, target); };
     uint32_t    num_cnots() const override { return 0; };
     std::string to_string() const override { return "t q[" + std::to_string(target) + "]"; };
 };
@@ -126,13 +130,10 @@ class T : public QGate, public U2 {
 class Tdg : public QGate, public U2 {
   public:
     using QGate::QGate;
+    using QGate::operator();
     Tdg(uint32_t target) : QGate(target), U2(1, 0, 0, std::exp(-1i * M_PI / 4.0)) {};
-    QRState operator()(const QRState& state, const bool reverse = false) const override {
-        return U2::operator()(state, target, reverse);
-    };
-    QState operator()(const QState& state, const bool reverse = false) const {
-        return U2::operator()(state, target, reverse);
-    };
+    void apply(QRState& state, const bool reverse = false) const override { U2::rotate(state, target, reverse); };
+    void lower(GateList& list) const override { list.add(GateKind::Tdg, target); };
     uint32_t    num_cnots() const override { return 0; };
     std::string to_string() const override { return "tdg q[" + std::to_string(target) + "]"; };
 };
@@ -140,13 +141,12 @@ class Tdg : public QGate, public U2 {
 class Sdg : public QGate, public U2 {
   public:
     using QGate::QGate;
+    using QGate::operator();
     Sdg(uint32_t target) : QGate(target), U2(1, 0, 0, std::exp(-1i * M_PI / 2.0)) {};
-    QRState operator()(const QRState& state, const bool reverse = false) const override {
+    void apply(QRState& state, const bool reverse = false) const override {
         throw std::runtime_error("Sdg introduces complex phase; use QState simulation");
     };
-    QState operator()(const QState& state, const bool reverse = false) const {
-        return U2::operator()(state, target, reverse);
-    };
+    void lower(GateList& list) const override { list.add(GateKind::Sdg, target); };
     uint32_t    num_cnots() const override { return 0; };
     std::string to_string() const override { return "sdg q[" + std::to_string(target) + "]"; };
 };
@@ -155,9 +155,8 @@ class Z : public QGate, public RU2 {
   public:
     using QGate::QGate;
     Z(uint32_t target) : QGate(target), RU2(1, 0, 0, -1) {};
-    QRState operator()(const QRState& state, const bool reverse = false) const override {
-        return RU2::operator()(state, target, reverse);
-    };
+    void apply(QRState& state, const bool reverse = false) const override { RU2::rotate(state, target, reverse); };
+    void lower(GateList& list) const override { list.add(GateKind::Z, target); };
     uint32_t    num_cnots() const override { return 0; };
     std::string to_string() const override { return "z q[" + std::to_string(target) + "]"; };
 };
@@ -165,8 +164,10 @@ class Z : public QGate, public RU2 {
 class S : public QGate, public U2 {
   public:
     using QGate::QGate;
+    using QGate::operator();
     S(uint32_t target) : QGate(target), U2(1, 0, 0, 1i) {};
-    QRState     operator()(const QRState& state, const bool reverse = false) const override;
+    void        apply(QRState& state, const bool reverse = false) const override;
+    void        lower(GateList& list) const override { list.add(GateKind::S, target); };
     uint32_t    num_cnots() const override { return 0; };
     std::string to_string() const override { return "s q[" + std::to_string(target) + "]"; };
 };
@@ -175,7 +176,11 @@ class Controlled {
   public:
     uint32_t ctrl;
     bool     phase;
-    Controlled(uint32_t ctrl, bool phase) : ctrl(ctrl), phase(phase) {};
+    index_t  ctrl_mask;
+    index_t  ctrl_value;
+    Controlled(uint32_t ctrl, bool phase)
+        : ctrl(ctrl), phase(phase), ctrl_mask(index_t(1) << ctrl), ctrl_value(phase ? ctrl_mask : 0) {};
+    bool                          is_active(index_t index) const { return (index & ctrl_mask) == ctrl_value; };
     virtual std::vector<uint32_t> qbits() const { return {ctrl}; };
 };
 
@@ -183,16 +188,27 @@ class MultiControlled {
   public:
     std::vector<uint32_t> ctrls;
     std::vector<bool>     phases;
+    index_t               ctrl_mask  = 0;
+    index_t               ctrl_value = 0;
     MultiControlled() = default;
-    MultiControlled(std::vector<uint32_t> ctrls) : ctrls(ctrls), phases(ctrls.size(), true) {};
-    MultiControlled(std::vector<uint32_t> ctrls, std::vector<bool> phases) : ctrls(ctrls), phases(phases) {};
+    MultiControlled(std::vector<uint32_t> ctrls) : MultiControlled(ctrls, std::vector<bool>(ctrls.size(), true)) {};
+    MultiControlled(std::vector<uint32_t> ctrls, std::vector<bool> phases) : ctrls(ctrls), phases(phases) {
+        for (uint32_t i = 0; i < this->ctrls.size(); i++) {
+            ctrl_mask |= index_t(1) << this->ctrls[i];
+            if (this->phases[i])
+                ctrl_value |= index_t(1) << this->ctrls[i];
+        }
+    };
+    bool                  is_active(index_t index) const { return (index & ctrl_mask) == ctrl_value; };
+    uint32_t              pattern_of(index_t index) const { return gather_bits(index, ctrls); };
     std::vector<uint32_t> qbits() const { return ctrls; };
 };
 
 class CRY : public Controlled, public RY {
   public:
     CRY(uint32_t ctrl, bool phase, double theta, uint32_t target) : Controlled(ctrl, phase), RY(target, theta) {};
-    QRState     operator()(const QRState& state, const bool reverse = false) const override;
+    void        apply(QRState& state, const bool reverse = false) const override;
+    void        lower(GateList& list) const override { list.add(GateKind::CRY, ctrl, phase, target, theta); };
     std::string to_string() const override {
         std::string gate = phase ? "cry" : "cry_false";
         return gate + "(" + std::to_string(theta) + ") q[" + std::to_string(ctrl) + "], q[" + std::to_string(target) +
@@ -207,7 +223,8 @@ class MCRY : public MultiControlled, public RY {
     MCRY(std::vector<uint32_t> ctrls, double theta, uint32_t target) : MultiControlled(ctrls), RY(target, theta) {};
     MCRY(std::vector<uint32_t> ctrls, std::vector<bool> phases, double theta, uint32_t target)
         : MultiControlled(ctrls, phases), RY(target, theta) {};
-    QRState     operator()(const QRState& state, const bool reverse = false) const override;
+    void        apply(QRState& state, const bool reverse = false) const override;
+    void        lower(GateList& list) const override { list.add_mcry(ctrls, phases, theta, target); };
     std::string to_string() const override {
         std::string gate = "mcry";
         for (uint32_t i = 0; i < ctrls.size(); i++)
@@ -220,7 +237,8 @@ class MCRY : public MultiControlled, public RY {
 class CX : public Controlled, public X {
   public:
     CX(uint32_t ctrl, bool phase, uint32_t target) : Controlled(ctrl, phase), X(target) {};
-    QRState     operator()(const QRState& state, const bool reverse = false) const override;
+    void        apply(QRState& state, const bool reverse = false) const override;
+    void        lower(GateList& list) const override { list.add(GateKind::CX, ctrl, phase, target); };
     std::string to_string() const override {
         std::string gate = phase ? "cx" : "cx_false";
         return gate + " q[" + std::to_string(ctrl) + "], q[" + std::to_string(target) + "]";
@@ -232,7 +250,8 @@ class CX : public Controlled, public X {
 class CCX : public MultiControlled, public X {
   public:
     CCX(uint32_t ctrl1, uint32_t ctrl2, uint32_t target) : MultiControlled({ctrl1, ctrl2}), X(target) {};
-    QRState     operator()(const QRState& state, const bool reverse = false) const override;
+    void        apply(QRState& state, const bool reverse = false) const override;
+    void        lower(GateList& list) const override { list.add_ccx(ctrls[0], ctrls[1], target); };
     std::string to_string() const override {
         return "ccx q[" + std::to_string(ctrls[0]) + "], q[" + std::to_string(ctrls[1]) + "], q[" +
                std::to_string(target) + "]";
@@ -246,7 +265,10 @@ class MCMY : public MultiControlled, public RY {
     std::vector<double> rotation_angles;
     MCMY(std::vector<uint32_t> ctrls, std::vector<bool> phases, std::vector<double> rotation_angles, uint32_t target)
         : MultiControlled(ctrls, phases), RY(target, 0.0), rotation_angles(rotation_angles) {};
-    QRState     operator()(const QRState& state, const bool reverse = false) const override;
+    void        apply(QRState& state, const bool reverse = false) const override;
+    void        lower(GateList& list) const override {
+        list.add_multiplexed(GateKind::MCMY, ctrls, phases, rotation_angles, target);
+    };
     std::string to_string() const override {
         std::string gate = "mcmy";
         for (uint32_t i = 0; i < ctrls.size(); i++)
@@ -266,7 +288,10 @@ class QROM_MCRY : public MultiControlled, public RY {
     QROM_MCRY(std::vector<uint32_t> ctrls, std::vector<bool> phases, std::vector<double> rotation_table,
               uint32_t target, double eps)
         : MultiControlled(ctrls, phases), RY(target, 0.0), eps(eps), rotation_table(rotation_table) {};
-    QRState     operator()(const QRState& state, const bool reverse = false) const override;
+    void        apply(QRState& state, const bool reverse = false) const override;
+    void        lower(GateList& list) const override {
+        list.add_multiplexed(GateKind::QROM_MCRY, ctrls, phases, rotation_table, target, eps);
+    };
     std::string to_string() const override {
         return "qrom_mcry q[" + std::to_string(target) + "], eps=" + std::to_string(eps);
     };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "weight-map.hpp"
+
 #include <complex>
 #include <cstdint>
 #include <iostream>
@@ -10,48 +12,77 @@
 #include <vector>
 
 namespace xyz {
+struct Signature {
+    std::vector<uint64_t> words;
+    bool                  none() const;
+    bool                  operator==(const Signature& other) const { return words == other.words; };
+    Signature             operator^(const Signature& other) const;
+};
+
+struct SignatureHash {
+    std::size_t operator()(const Signature& signature) const;
+};
+
 class QRState {
   private:
     mutable std::optional<uint64_t> hash_value = std::nullopt;
 
   public:
-    uint32_t                   n_bits = 0;
-    std::map<uint32_t, double> index_to_weight;
+    uint32_t          n_bits = 0;
+    WeightMap<double> index_to_weight;
     QRState() = default;
-    QRState(std::map<uint32_t, double>& index_to_weight, uint32_t n_bits)
+    template <typename K>
+    QRState(const std::map<K, double>& index_to_weight, uint32_t n_bits)
         : index_to_weight(index_to_weight), n_bits(n_bits) {};
-    std::unordered_map<uint32_t, double> to_ry_table(uint32_t target) const;
-    bool                                 is_ground() const;
-    friend std::ostream&                 operator<<(std::ostream& os, const QRState& obj);
-    static constexpr double              eps = 1e-6;
-    uint64_t                             repr() const;
-    QRState                              clone() const;
-    uint32_t                             cardinality() const { return index_to_weight.size(); };
-    std::string                          to_string() const;
-    bool                                 operator==(const QRState& other) const;
-    std::vector<uint32_t>                get_supports() const;
-    std::vector<uint64_t>                get_qubit_signatures() const;
-    uint64_t                             get_const1_signature() const;
-    std::optional<double>                get_ap_ry_angles(uint32_t qubit_index) const;
+    QRState(WeightMap<double> index_to_weight, uint32_t n_bits)
+        : index_to_weight(std::move(index_to_weight)), n_bits(n_bits) {};
+    std::unordered_map<index_t, double, IndexHash> to_ry_table(uint32_t target) const;
+    bool                                           is_ground() const;
+    friend std::ostream&                           operator<<(std::ostream& os, const QRState& obj);
+    static constexpr double                        eps = 1e-6;
+    static inline double                           dense_fill        = 0.5;
+    static inline double                           sparse_fill       = 0.25;
+    static inline uint32_t                         dense_min_bits    = 12;
+    static inline uint32_t                         dense_max_bits    = 30;
+    static inline std::size_t                      parallel_min_size = std::size_t(1) << 16;
+    void                                           update_storage();
+    bool                                           is_dense() const { return index_to_weight.is_dense(); };
+    uint64_t                                       repr() const;
+    std::optional<uint64_t>                        cached_repr() const { return hash_value; };
+    void                                           set_repr(std::optional<uint64_t> h) const { hash_value = h; };
+    static uint64_t                                repr_seed(uint32_t n_bits);
+    static uint64_t                                repr_term(index_t index, double weight);
+    QRState                                        clone() const;
+    uint32_t                                       cardinality() const { return index_to_weight.size(); };
+    std::string                                    to_string() const;
+    bool                                           operator==(const QRState& other) const;
+    std::vector<uint32_t>                          get_supports() const;
+    std::vector<Signature>                         get_qubit_signatures() const;
+    Signature                                      get_const1_signature() const;
+    std::optional<double>                          get_ap_ry_angles(uint32_t qubit_index) const;
 };
 
 struct QRStateHash {
     std::size_t operator()(const QRState& state) const { return state.repr(); }
 };
-QRState ground_rstate(uint32_t n_bits);
-QRState dicke_state(uint32_t n, uint32_t k);
-QRState random_rstate(uint32_t n_bits, uint32_t cardinality, uint64_t seed = 0);
+uint64_t splitmix64(uint64_t x);
+QRState  ground_rstate(uint32_t n_bits);
+QRState  dicke_state(uint32_t n, uint32_t k);
+QRState  random_rstate(uint32_t n_bits, uint32_t cardinality, uint64_t seed = 0);
 
 class QState {
   private:
     mutable std::optional<uint64_t> hash_value = std::nullopt;
 
   public:
-    uint32_t                                 n_bits = 0;
-    std::map<uint32_t, std::complex<double>> index_to_weight;
+    uint32_t                        n_bits = 0;
+    WeightMap<std::complex<double>> index_to_weight;
     QState() = default;
-    QState(std::map<uint32_t, std::complex<double>>& index_to_weight, uint32_t n_bits)
+    template <typename K>
+    QState(const std::map<K, std::complex<double>>& index_to_weight, uint32_t n_bits)
         : index_to_weight(index_to_weight), n_bits(n_bits) {};
+    QState(WeightMap<std::complex<double>> index_to_weight, uint32_t n_bits)
+        : index_to_weight(std::move(index_to_weight)), n_bits(n_bits) {};
     friend std::ostream&    operator<<(std::ostream& os, const QState& obj);
     static constexpr double eps = 1e-6;
 };
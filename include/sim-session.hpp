@@ -0,0 +1,37 @@
+#pragma once
+
+#include "gate-ir.hpp"
+#include "qcircuit.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace xyz {
+
+/* repeated simulation of successive versions of one circuit from a fixed initial state; every `interval`
+ * gates the state is checkpointed under the hash of the gate prefix, so after a local edit a run resumes
+ * from the last checkpoint before the edit instead of from the first gate */
+class SimSession {
+  public:
+    explicit SimSession(const QRState& initial, uint32_t interval = 32);
+
+    QRState     run(const GateList& list);
+    QRState     run(const QCircuit& circuit) { return run(circuit.to_gate_list()); };
+    uint32_t    last_resumed() const { return resumed; };
+    uint32_t    last_applied() const { return applied; };
+    std::size_t num_checkpoints() const { return checkpoints.size(); };
+
+  private:
+    struct Checkpoint {
+        uint32_t length;
+        QRState  state;
+    };
+
+    QRState                                  initial;
+    uint32_t                                 interval;
+    uint32_t                                 resumed = 0;
+    uint32_t                                 applied = 0;
+    std::unordered_map<uint64_t, Checkpoint> checkpoints;
+};
+
+} // namespace xyz
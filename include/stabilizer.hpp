@@ -0,0 +1,60 @@
+#pragma once
+
+#include "gate-ir.hpp"
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+namespace xyz {
+
+/* CH-form stabilizer state omega * U_C * U_H |s> (Bravyi et al. 2019); the C-type Clifford U_C is kept as
+ * U_C^-1 Z_p U_C = Z^G[p] and U_C^-1 X_p U_C = i^gamma[p] X^F[p] Z^M[p] with one bitmask per row,
+ * so every gate costs O(n) word operations and an amplitude O(n) */
+class CHForm {
+  public:
+    uint32_t             n_bits = 0;
+    std::complex<double> omega  = 1.0;
+
+    explicit CHForm(uint32_t n_bits);
+    void                 apply_h(uint32_t q);
+    void                 apply_s(uint32_t q);
+    void                 apply_sdg(uint32_t q);
+    void                 apply_z(uint32_t q);
+    void                 apply_x(uint32_t q);
+    void                 apply_cx(uint32_t ctrl, uint32_t target);
+    void                 apply_cz(uint32_t q, uint32_t r);
+    std::complex<double> amplitude(index_t x) const;
+
+  private:
+    std::vector<index_t> F, G, M;
+    std::vector<uint8_t> gamma;
+    index_t              v = 0, s = 0;
+
+    void update_sum(index_t t, index_t u, uint32_t delta, uint32_t alpha);
+    void cx_right(uint32_t q, uint32_t r);
+    void cz_right(uint32_t q, uint32_t r);
+    void s_right(uint32_t q);
+};
+
+/* T = alpha I + beta S with |alpha| = |beta|: the exact sum has 2^t CH-form terms, while sampling
+ * draws each branch with equal probability and averages n_samples unbiased estimates */
+struct stabilizer_params {
+    uint32_t n_samples  = 0; // 0 sums every branch exactly
+    uint64_t seed       = 0;
+    stabilizer_params() = default;
+    stabilizer_params(uint32_t n_samples, uint64_t seed = 0) : n_samples(n_samples), seed(seed) {}
+};
+
+constexpr uint32_t stabilizer_max_exact_t = 32;
+
+uint32_t t_count(const GateList& list);
+
+/* amplitudes <x|U|0^n> of a Clifford+T list (H, S, Sdg, T, Tdg, X, Z, CX, CCX) */
+std::vector<std::complex<double>> stabilizer_amplitudes(const GateList& list, const std::vector<index_t>& xs,
+                                                        const stabilizer_params& params = stabilizer_params());
+/* <target|U|0^n>; the fidelity of a prepared state is its squared magnitude */
+std::complex<double> stabilizer_overlap(const GateList& list, const QRState& target,
+                                        const stabilizer_params& params = stabilizer_params());
+
+} // namespace xyz
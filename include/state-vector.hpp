@@ -0,0 +1,78 @@
+#pragma once
+
+#include "gate-ir.hpp"
+#include "phase-polynomial.hpp"
+#include "thread-pool.hpp"
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace xyz {
+
+/* cache-line aligned storage so that full-width vector loads never straddle two lines */
+template <typename T, std::size_t Align = 64> struct AlignedAllocator {
+    using value_type = T;
+    template <typename U> struct rebind {
+        using other = AlignedAllocator<U, Align>;
+    };
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+    T* allocate(std::size_t n) {
+        std::size_t bytes = (n * sizeof(T) + Align - 1) / Align * Align;
+        if (void* p = std::aligned_alloc(Align, bytes))
+            return static_cast<T*>(p);
+        throw std::bad_alloc();
+    };
+    void deallocate(T* p, std::size_t) { std::free(p); };
+    template <typename U> bool operator==(const AlignedAllocator<U, Align>&) const { return true; };
+    template <typename U> bool operator!=(const AlignedAllocator<U, Align>&) const { return false; };
+};
+
+/* all 2^n amplitudes in one contiguous array; every gate is a single pass over amplitude pairs
+ * whose range is split across the pool */
+template <typename T> class StateVector {
+  public:
+    uint32_t                            n_bits = 0;
+    std::vector<T, AlignedAllocator<T>> amplitudes;
+
+    StateVector(const WeightMap<T>& map, uint32_t n_bits);
+    WeightMap<T> to_weight_map(double eps) const;
+    void         apply(const GateList& list, const GateOp& op, ThreadPool& pool, const bool reverse = false);
+    void         apply(const PhasePolynomial& poly, ThreadPool& pool);
+};
+
+extern template class StateVector<double>;
+extern template class StateVector<std::complex<double>>;
+
+/* 2^30 complex amplitudes already take 16 GiB */
+constexpr uint32_t dense_engine_max_bits = 30;
+
+/* B real states over the same qubits stored structure-of-arrays: row i holds amplitude i of every state,
+ * padded to a multiple of four columns, so a gate is one pass over the pairs that rotates whole rows */
+class StateBatch {
+  public:
+    uint32_t                                      n_bits = 0;
+    std::size_t                                   batch  = 0;
+    std::size_t                                   width  = 0;
+    std::vector<double, AlignedAllocator<double>> amplitudes;
+
+    StateBatch(const std::vector<QRState>& states, uint32_t n_bits);
+    QRState state(std::size_t k) const;
+    void    apply(const GateList& list, const GateOp& op, ThreadPool& pool, const bool reverse = false);
+};
+
+bool    prefer_dense(const GateList& list, uint32_t n_bits, std::size_t cardinality, uint32_t max_bits);
+QRState simulate_dense(const GateList& list, const QRState& state, uint32_t n_threads = 0);
+QState  simulate_dense(const GateList& list, const QState& state, uint32_t n_threads = 0, uint32_t phase_run = 2);
+
+/* one walk over the list for all states; each result equals simulate(list, states[k]). When the rows
+ * would not fit 2^sim_params::dense_max_bits amplitudes, or wide states are not expected to fill up, the
+ * states are simulated sparsely one by one, spread over the pool */
+std::vector<QRState> simulate_batch(const GateList& list, const std::vector<QRState>& states, uint32_t n_threads = 0);
+
+} // namespace xyz
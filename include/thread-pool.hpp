@@ -0,0 +1,70 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xyz {
+
+/* fixed set of workers that run one job at a time; chunk c runs on thread c % size() with the caller as
+ * thread 0, and a call made while the pool is busy (from a job or another thread) runs its chunks inline.
+ * The first exception a chunk throws is rethrown by run() once every thread is done with the job */
+class ThreadPool {
+  public:
+    explicit ThreadPool(uint32_t n_threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t size() const { return (uint32_t)workers.size() + 1; };
+    void     run(uint32_t n_chunks, const std::function<void(uint32_t)>& job);
+
+    /* fn(begin, end) over [0, n) in at most size() contiguous chunks of at least `grain` items */
+    template <typename Fn> void parallel_for(std::size_t n, std::size_t grain, Fn&& fn) {
+        std::size_t n_chunks = std::min<std::size_t>(size(), grain ? (n + grain - 1) / grain : n);
+        if (n_chunks <= 1) {
+            fn(std::size_t(0), n);
+            return;
+        }
+        std::size_t step = (n + n_chunks - 1) / n_chunks;
+        run((uint32_t)n_chunks, [&](uint32_t chunk) {
+            std::size_t begin = chunk * step;
+            std::size_t end   = std::min(n, begin + step);
+            if (begin < end)
+                fn(begin, end);
+        });
+    };
+
+  private:
+    void worker(uint32_t index);
+
+    std::vector<std::thread>             workers;
+    std::atomic<bool>                    busy{false};
+    std::mutex                           mutex;
+    std::condition_variable              start;
+    std::condition_variable              done;
+    const std::function<void(uint32_t)>* current    = nullptr;
+    uint32_t                             n_chunks   = 0;
+    uint32_t                             pending    = 0;
+    uint64_t                             generation = 0;
+    bool                                 stopping   = false;
+    std::exception_ptr                   failure;
+};
+
+/* process-wide pool shared by the sparse kernels, sized to the hardware until resized; resizing
+ * must not race with kernels running on it */
+ThreadPool& shared_pool();
+void        resize_shared_pool(uint32_t n_threads);
+
+/* the shared pool when n_threads is 0 or its size, otherwise a private pool of n_threads kept in own */
+ThreadPool& pool_for(uint32_t n_threads, std::unique_ptr<ThreadPool>& own);
+
+} // namespace xyz
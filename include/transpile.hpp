@@ -8,5 +8,6 @@
 namespace xyz {
 
 QCircuit transpile_clifford_t(const QCircuit& in, double eps);
+GateList transpile_clifford_t(const GateList& in, double eps);
 
 } // namespace xyz
@@ -9,6 +9,7 @@
 namespace xyz {
 
 class QGate;
+class GateList;
 
 using Complex   = std::complex<double>;
 using Matrix2x2 = std::array<std::array<Complex, 2>, 2>;
@@ -27,5 +28,6 @@ Matrix2x2 mat_Tdg();
 Matrix2x2 mat_Ry(double theta);
 
 std::vector<std::shared_ptr<QGate>> approximate_ry_sk(uint32_t target, double theta, double eps);
+void                                approximate_ry_sk(uint32_t target, double theta, double eps, GateList& out);
 
 } // namespace xyz
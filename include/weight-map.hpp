@@ -0,0 +1,300 @@
+#pragma once
+
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace xyz {
+
+#if XYZ_INDEX_BITS == 32
+using index_t = uint32_t;
+#elif XYZ_INDEX_BITS == 128
+using index_t = unsigned __int128;
+#else
+using index_t = uint64_t;
+#endif
+
+constexpr uint32_t index_bits = 8 * sizeof(index_t);
+
+inline index_t index_mask(uint32_t n_bits) {
+    return n_bits >= index_bits ? ~index_t(0) : (index_t(1) << n_bits) - 1;
+}
+
+/* bit j of the result is bit positions[j] of index */
+inline uint32_t gather_bits(index_t index, const std::vector<uint32_t>& positions) {
+    uint32_t result = 0;
+    for (uint32_t j = 0; j < positions.size(); j++)
+        result |= (uint32_t)((index >> positions[j]) & 1u) << j;
+    return result;
+}
+
+struct IndexHash {
+    std::size_t operator()(index_t index) const {
+        if constexpr (sizeof(index_t) > 8)
+            return std::hash<uint64_t>()((uint64_t)index ^ (uint64_t)(index >> 32 >> 32) * 0x9e3779b97f4a7c15ull);
+        else
+            return std::hash<uint64_t>()((uint64_t)index);
+    };
+};
+
+template <typename T> class WeightMap {
+  public:
+    using value_type     = std::pair<index_t, T>;
+    using iterator       = typename std::pmr::vector<value_type>::iterator;
+    class const_iterator;
+
+    struct Storage {
+        std::pmr::vector<value_type> entries{state_resource()};
+        std::pmr::vector<T>          dense{state_resource()};
+        std::size_t                  dense_size = 0;
+        Storage()                               = default;
+        Storage(const Storage& other)
+            : entries(other.entries, state_resource()), dense(other.dense, state_resource()),
+              dense_size(other.dense_size) {};
+    };
+
+    WeightMap() : storage(make_storage()) {};
+    template <typename K> WeightMap(const std::map<K, T>& m) : storage(make_storage()) {
+        storage->entries.assign(m.begin(), m.end());
+    };
+
+    const std::pmr::vector<value_type>& entries() const { return storage->entries; };
+    const std::pmr::vector<T>&          dense() const { return storage->dense; };
+    bool     shares_storage(const WeightMap& other) const { return storage == other.storage; };
+    Storage& edit() {
+        if (storage.use_count() > 1)
+            storage = make_storage(*storage);
+        return *storage;
+    };
+    Storage& rewrite() {
+        if (storage.use_count() > 1)
+            storage = make_storage();
+        return *storage;
+    };
+
+    bool is_dense() const { return !storage->dense.empty(); };
+    void make_dense(uint32_t n_bits) {
+        if (is_dense())
+            return;
+        auto dense_storage = make_storage();
+        dense_storage->dense.assign(std::size_t(1) << n_bits, T(0));
+        for (const auto& [index, weight] : storage->entries)
+            dense_storage->dense[(std::size_t)index] = weight;
+        dense_storage->dense_size = storage->entries.size();
+        storage                   = std::move(dense_storage);
+    };
+    void make_sparse() {
+        if (!is_dense())
+            return;
+        auto        sparse_storage = make_storage();
+        const auto& d              = storage->dense;
+        sparse_storage->entries.reserve(storage->dense_size);
+        for (std::size_t index = 0; index < d.size(); index++)
+            if (d[index] != T(0))
+                sparse_storage->entries.emplace_back((index_t)index, d[index]);
+        storage = std::move(sparse_storage);
+    };
+
+    template <typename Fn> void for_each(Fn&& fn) const {
+        if (!is_dense()) {
+            for (const auto& [index, weight] : storage->entries)
+                fn(index, weight);
+            return;
+        }
+        const auto& d = storage->dense;
+        for (std::size_t index = 0; index < d.size(); index++)
+            if (d[index] != T(0))
+                fn((index_t)index, d[index]);
+    };
+    T get(index_t index) const {
+        if (is_dense())
+            return index < storage->dense.size() ? storage->dense[(std::size_t)index] : T(0);
+        auto it = sparse_lower_bound(index);
+        return (it != storage->entries.cend() && it->first == index) ? it->second : T(0);
+    };
+
+    iterator begin() {
+        make_sparse();
+        return edit().entries.begin();
+    };
+    iterator end() {
+        make_sparse();
+        return edit().entries.end();
+    };
+    const_iterator begin() const { return const_iterator(storage.get(), 0); };
+    const_iterator end() const {
+        return const_iterator(storage.get(), is_dense() ? storage->dense.size() : storage->entries.size());
+    };
+    std::size_t size() const { return is_dense() ? storage->dense_size : storage->entries.size(); };
+    bool        empty() const { return size() == 0; };
+    void        reserve(std::size_t n) {
+        make_sparse();
+        edit().entries.reserve(n);
+    };
+    void     clear() { storage = make_storage(); };
+    void     push_back(index_t index, const T& weight) {
+        make_sparse();
+        edit().entries.emplace_back(index, weight);
+    };
+    /* it comes from a non-const accessor, which already detached the storage; the offset keeps it valid if
+     * the map was copied since */
+    iterator erase(iterator it) {
+        const auto offset  = it - storage->entries.begin();
+        auto&      entries = edit().entries;
+        return entries.erase(entries.begin() + offset);
+    };
+
+    const_iterator lower_bound(index_t index) const {
+        if (is_dense())
+            return const_iterator(storage.get(), (std::size_t)std::min<index_t>(index, storage->dense.size()));
+        return const_iterator(storage.get(), sparse_lower_bound(index) - storage->entries.cbegin());
+    };
+    iterator lower_bound(index_t index) {
+        make_sparse();
+        auto& entries = edit().entries;
+        return std::lower_bound(entries.begin(), entries.end(), index,
+                                [](const value_type& e, index_t i) { return e.first < i; });
+    };
+    const_iterator find(index_t index) const {
+        auto it = lower_bound(index);
+        return (it != end() && it->first == index) ? it : end();
+    };
+    iterator find(index_t index) {
+        auto it = lower_bound(index);
+        return (it != storage->entries.end() && it->first == index) ? it : storage->entries.end();
+    };
+    const T& at(index_t index) const {
+        if (is_dense()) {
+            if (index >= storage->dense.size() || storage->dense[(std::size_t)index] == T(0))
+                throw std::out_of_range("WeightMap::at");
+            return storage->dense[(std::size_t)index];
+        }
+        auto it = sparse_lower_bound(index);
+        if (it == storage->entries.cend() || it->first != index)
+            throw std::out_of_range("WeightMap::at");
+        return it->second;
+    };
+    T& operator[](index_t index) {
+        auto it = lower_bound(index);
+        if (it == storage->entries.end() || it->first != index)
+            it = storage->entries.emplace(it, index, T{});
+        return it->second;
+    };
+    std::map<index_t, T> to_map() const {
+        std::map<index_t, T> m;
+        for_each([&](index_t index, const T& weight) { m.emplace_hint(m.end(), index, weight); });
+        return m;
+    };
+
+  private:
+    std::shared_ptr<Storage> storage;
+
+    typename std::pmr::vector<value_type>::const_iterator sparse_lower_bound(index_t index) const {
+        return std::lower_bound(storage->entries.cbegin(), storage->entries.cend(), index,
+                                [](const value_type& e, index_t i) { return e.first < i; });
+    };
+
+    template <typename... Args> static std::shared_ptr<Storage> make_storage(Args&&... args) {
+        return std::allocate_shared<Storage>(std::pmr::polymorphic_allocator<Storage>(state_resource()),
+                                             std::forward<Args>(args)...);
+    };
+};
+
+/* walks the nonzero entries in index order in either layout, without converting it; entries are yielded
+ * by value, since dense storage holds no pairs */
+template <typename T> class WeightMap<T>::const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = std::pair<index_t, T>;
+    using difference_type   = std::ptrdiff_t;
+    using reference         = value_type;
+    struct pointer {
+        value_type        entry;
+        const value_type* operator->() const { return &entry; };
+    };
+
+    const_iterator() = default;
+    const_iterator(const Storage* storage, std::size_t pos) : storage(storage), pos(pos) { skip_zeros(); };
+
+    value_type operator*() const {
+        return storage->dense.empty() ? storage->entries[pos] : value_type((index_t)pos, storage->dense[pos]);
+    };
+    pointer         operator->() const { return pointer{**this}; };
+    const_iterator& operator++() {
+        pos++;
+        skip_zeros();
+        return *this;
+    };
+    const_iterator operator++(int) {
+        const_iterator it = *this;
+        ++*this;
+        return it;
+    };
+    bool operator==(const const_iterator& other) const { return pos == other.pos; };
+    bool operator!=(const const_iterator& other) const { return pos != other.pos; };
+
+  private:
+    void skip_zeros() {
+        const auto& d = storage->dense;
+        while (pos < d.size() && d[pos] == T(0))
+            pos++;
+    };
+
+    const Storage* storage = nullptr;
+    std::size_t    pos     = 0;
+};
+
+/* pairs of a sorted entry slice that starts and ends on a change of index >> (target + 1) */
+template <typename T, typename Fn>
+void for_each_pair_in(const std::pair<index_t, T>* e, std::size_t n, index_t bit, Fn&& fn) {
+    std::size_t i = 0, j = 0;
+    while (i < n && (e[i].first & bit))
+        i++;
+    while (j < n && !(e[j].first & bit))
+        j++;
+    while (i < n || j < n) {
+        bool use0 = i < n && (j >= n || e[i].first <= (e[j].first ^ bit));
+        bool use1 = j < n && (i >= n || (e[j].first ^ bit) <= e[i].first);
+        if (use0 && use1) {
+            fn(e[i].first, &e[i].second, &e[j].second);
+        } else if (use0) {
+            fn(e[i].first, &e[i].second, (const T*)nullptr);
+        } else {
+            fn(e[j].first ^ bit, (const T*)nullptr, &e[j].second);
+        }
+        if (use0)
+            do
+                i++;
+            while (i < n && (e[i].first & bit));
+        if (use1)
+            do
+                j++;
+            while (j < n && !(e[j].first & bit));
+    }
+}
+
+template <typename T, typename Fn> void for_each_pair(const WeightMap<T>& m, uint32_t target, Fn&& fn) {
+    const index_t bit = index_t(1) << target;
+    if (m.is_dense()) {
+        const auto& d = m.dense();
+        for (std::size_t base = 0; base < d.size(); base += 2 * (std::size_t)bit)
+            for (std::size_t i = base; i < base + bit; i++) {
+                const bool has0 = d[i] != T(0), has1 = d[i + bit] != T(0);
+                if (has0 || has1)
+                    fn((index_t)i, has0 ? &d[i] : (const T*)nullptr, has1 ? &d[i + bit] : (const T*)nullptr);
+            }
+        return;
+    }
+    for_each_pair_in(m.entries().data(), m.entries().size(), bit, fn);
+}
+
+} // namespace xyz
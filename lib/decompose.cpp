@@ -81,8 +81,8 @@ std::vector<std::shared_ptr<QGate>> decompose_mcry(const MCRY& gate) {
         uint32_t control_id = __builtin_ctz(diff);
         prev_gray           = curr_gray;
 
-        gates.push_back(std::make_shared<RY>(gate.target, thetas[i]));
-        gates.push_back(std::make_shared<CX>(gate.ctrls[control_id], true, gate.target));
+        gates.push_back(make_gate<RY>(gate.target, thetas[i]));
+        gates.push_back(make_gate<CX>(gate.ctrls[control_id], true, gate.target));
     }
 
     return gates;
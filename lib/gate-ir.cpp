@@ -0,0 +1,507 @@
+#include "gate-ir.hpp"
+
+#include "kernels.hpp"
+#include "permutation.hpp"
+#include "phase-polynomial.hpp"
+#include "qgate.hpp"
+#include "state-vector.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace xyz {
+using namespace kernels;
+
+void GateList::add(GateKind kind, uint32_t target, double theta) {
+    GateOp op;
+    op.kind     = kind;
+    op.qbits[0] = target;
+    op.theta    = theta;
+    switch (kind) {
+    case GateKind::H:
+        op.coef = {constants::sqrt2_inv, constants::sqrt2_inv, constants::sqrt2_inv, -constants::sqrt2_inv};
+        break;
+    case GateKind::Z:
+        op.coef = {1.0, 0.0, 0.0, -1.0};
+        break;
+    case GateKind::T:
+        op.coef = {1.0, 0.0, 0.0, std::exp(1i * M_PI / 4.0).real()};
+        break;
+    case GateKind::Tdg:
+        op.coef = {1.0, 0.0, 0.0, std::exp(-1i * M_PI / 4.0).real()};
+        break;
+    case GateKind::RY:
+        op.coef = {cos(theta / 2), sin(theta / 2), -sin(theta / 2), cos(theta / 2)};
+        break;
+    default:
+        break;
+    }
+    ops.push_back(op);
+}
+
+void GateList::add(GateKind kind, uint32_t ctrl, bool phase, uint32_t target, double theta) {
+    add(kind == GateKind::CRY ? GateKind::RY : GateKind::X, target, theta);
+    GateOp& op    = ops.back();
+    op.kind       = kind;
+    op.phase      = phase;
+    op.n_ctrls    = 1;
+    op.qbits[1]   = ctrl;
+    op.ctrl_mask  = index_t(1) << ctrl;
+    op.ctrl_value = phase ? op.ctrl_mask : 0;
+}
+
+void GateList::add_ccx(uint32_t ctrl1, uint32_t ctrl2, uint32_t target) {
+    add(GateKind::X, target);
+    GateOp& op    = ops.back();
+    op.kind       = GateKind::CCX;
+    op.n_ctrls    = 2;
+    op.qbits[1]   = ctrl1;
+    op.qbits[2]   = ctrl2;
+    op.ctrl_mask  = (index_t(1) << ctrl1) | (index_t(1) << ctrl2);
+    op.ctrl_value = op.ctrl_mask;
+}
+
+void GateList::add_unitary(uint32_t target, const std::array<double, 4>& coef) {
+    add(GateKind::Unitary, target);
+    ops.back().coef = coef;
+}
+
+void GateList::add_mcry(const std::vector<uint32_t>& ctrls, const std::vector<bool>& phases, double theta,
+                        uint32_t target) {
+    add_multiplexed(GateKind::MCRY, ctrls, phases, {}, target);
+    GateOp& op = ops.back();
+    op.theta   = theta;
+    op.coef    = {cos(theta / 2), sin(theta / 2), -sin(theta / 2), cos(theta / 2)};
+}
+
+void GateList::add_multiplexed(GateKind kind, const std::vector<uint32_t>& ctrls, const std::vector<bool>& phases,
+                               const std::vector<double>& table, uint32_t target, double eps) {
+    GateOp op;
+    op.kind         = kind;
+    op.n_ctrls      = (uint8_t)ctrls.size();
+    op.qbits[0]     = target;
+    op.ctrl_offset  = (uint32_t)this->ctrls.size();
+    op.param_offset = (uint32_t)params.size();
+    op.n_params     = (uint32_t)table.size();
+    for (uint32_t i = 0; i < ctrls.size(); i++) {
+        this->ctrls.push_back(ctrls[i]);
+        this->phases.push_back(phases[i]);
+        op.ctrl_mask |= index_t(1) << ctrls[i];
+        if (phases[i])
+            op.ctrl_value |= index_t(1) << ctrls[i];
+    }
+    params.insert(params.end(), table.begin(), table.end());
+    if (kind == GateKind::QROM_MCRY)
+        params.push_back(eps);
+    ops.push_back(op);
+}
+
+void GateList::append(const GateList& other, const GateOp& op) {
+    switch (op.kind) {
+    case GateKind::MCRY:
+        add_mcry(other.ctrls_of(op), other.phases_of(op), op.theta, op.target());
+        break;
+    case GateKind::MCMY:
+        add_multiplexed(op.kind, other.ctrls_of(op), other.phases_of(op), other.params_of(op), op.target());
+        break;
+    case GateKind::QROM_MCRY:
+        add_multiplexed(op.kind, other.ctrls_of(op), other.phases_of(op), other.params_of(op), op.target(),
+                        other.eps_of(op));
+        break;
+    default:
+        ops.push_back(op);
+        break;
+    }
+}
+
+std::vector<uint32_t> GateList::ctrls_of(const GateOp& op) const {
+    if (op.kind == GateKind::CX || op.kind == GateKind::CRY || op.kind == GateKind::CCX)
+        return std::vector<uint32_t>(op.qbits.begin() + 1, op.qbits.begin() + 1 + op.n_ctrls);
+    return std::vector<uint32_t>(ctrls.begin() + op.ctrl_offset, ctrls.begin() + op.ctrl_offset + op.n_ctrls);
+}
+
+std::vector<bool> GateList::phases_of(const GateOp& op) const {
+    if (op.kind == GateKind::CX || op.kind == GateKind::CRY || op.kind == GateKind::CCX)
+        return std::vector<bool>(op.n_ctrls, op.phase);
+    return std::vector<bool>(phases.begin() + op.ctrl_offset, phases.begin() + op.ctrl_offset + op.n_ctrls);
+}
+
+std::vector<double> GateList::params_of(const GateOp& op) const {
+    return std::vector<double>(params.begin() + op.param_offset, params.begin() + op.param_offset + op.n_params);
+}
+
+/* exact content hash: angles by bit pattern, side-table controls and parameters included */
+uint64_t GateList::hash_of(const GateOp& op) const {
+    auto mix  = [](uint64_t h, uint64_t v) { return splitmix64(h ^ v); };
+    auto bits = [](double x) {
+        uint64_t b;
+        std::memcpy(&b, &x, sizeof(b));
+        return b;
+    };
+    uint64_t h = mix((uint64_t)op.kind, (uint64_t)op.phase << 8 | (uint64_t)op.n_ctrls << 16);
+    for (uint32_t q : op.qbits)
+        h = mix(h, q);
+    h = mix(h, bits(op.theta));
+    for (double c : op.coef)
+        h = mix(h, bits(c));
+    if (op.kind == GateKind::MCRY || op.kind == GateKind::MCMY || op.kind == GateKind::QROM_MCRY)
+        for (uint32_t i = op.ctrl_offset; i < op.ctrl_offset + op.n_ctrls; i++)
+            h = mix(h, (uint64_t)ctrls[i] << 1 | phases[i]);
+    const uint32_t n_params = op.n_params + (op.kind == GateKind::QROM_MCRY);
+    for (uint32_t i = op.param_offset; i < op.param_offset + n_params; i++)
+        h = mix(h, bits(params[i]));
+    return h;
+}
+
+std::string GateList::to_string(const GateOp& op) const {
+    const std::string t = "q[" + std::to_string(op.target()) + "]";
+    switch (op.kind) {
+    case GateKind::X:
+        return "x " + t;
+    case GateKind::H:
+        return "h " + t;
+    case GateKind::Z:
+        return "z " + t;
+    case GateKind::T:
+        return "t " + t;
+    case GateKind::Tdg:
+        return "tdg " + t;
+    case GateKind::S:
+        return "s " + t;
+    case GateKind::Sdg:
+        return "sdg " + t;
+    case GateKind::RY:
+        return "ry(" + std::to_string(op.theta) + ") " + t;
+    case GateKind::CX:
+        return std::string(op.phase ? "cx" : "cx_false") + " q[" + std::to_string(op.qbits[1]) + "], " + t;
+    case GateKind::CRY:
+        return std::string(op.phase ? "cry" : "cry_false") + "(" + std::to_string(op.theta) + ") q[" +
+               std::to_string(op.qbits[1]) + "], " + t;
+    case GateKind::CCX:
+        return "ccx q[" + std::to_string(op.qbits[1]) + "], q[" + std::to_string(op.qbits[2]) + "], " + t;
+    case GateKind::MCRY:
+    case GateKind::MCMY: {
+        std::string gate = op.kind == GateKind::MCRY ? "mcry" : "mcmy";
+        for (uint32_t i = 0; i < op.n_ctrls; i++)
+            gate += "[" + std::to_string(ctrls[op.ctrl_offset + i]) + "]";
+        if (op.kind == GateKind::MCRY)
+            gate += "(" + std::to_string(op.theta) + ")";
+        return gate + " " + t;
+    }
+    case GateKind::QROM_MCRY:
+        return "qrom_mcry " + t + ", eps=" + std::to_string(eps_of(op));
+    case GateKind::Unitary:
+        return "unitary(" + std::to_string(op.coef[0]) + ", " + std::to_string(op.coef[1]) + ", " +
+               std::to_string(op.coef[2]) + ", " + std::to_string(op.coef[3]) + ") " + t;
+    }
+    return "";
+}
+
+std::shared_ptr<QGate> GateList::to_gate(const GateOp& op) const {
+    switch (op.kind) {
+    case GateKind::X:
+        return make_gate<X>(op.target());
+    case GateKind::H:
+        return make_gate<H>(op.target());
+    case GateKind::Z:
+        return make_gate<Z>(op.target());
+    case GateKind::T:
+        return make_gate<T>(op.target());
+    case GateKind::Tdg:
+        return make_gate<Tdg>(op.target());
+    case GateKind::S:
+        return make_gate<S>(op.target());
+    case GateKind::Sdg:
+        return make_gate<Sdg>(op.target());
+    case GateKind::RY:
+        return make_gate<RY>(op.target(), op.theta);
+    case GateKind::CX:
+        return make_gate<CX>(op.qbits[1], op.phase, op.target());
+    case GateKind::CRY:
+        return make_gate<CRY>(op.qbits[1], op.phase, op.theta, op.target());
+    case GateKind::CCX:
+        return make_gate<CCX>(op.qbits[1], op.qbits[2], op.target());
+    case GateKind::MCRY:
+        return make_gate<MCRY>(ctrls_of(op), phases_of(op), op.theta, op.target());
+    case GateKind::MCMY:
+        return make_gate<MCMY>(ctrls_of(op), phases_of(op), params_of(op), op.target());
+    case GateKind::QROM_MCRY:
+        return make_gate<QROM_MCRY>(ctrls_of(op), phases_of(op), params_of(op), op.target(), eps_of(op));
+    case GateKind::Unitary:
+        throw std::runtime_error("fused unitary has no QGate counterpart");
+    }
+    return nullptr;
+}
+
+std::string GateList::to_qasm2() const {
+    std::string qasm = "";
+    qasm += "OPENQASM 2.0;\n";
+    qasm += "include \"qelib1.inc\";\n";
+    qasm += "qreg q[" + std::to_string(num_qbits) + "];\n";
+    for (const auto& op : ops)
+        qasm += to_string(op) + ";\n";
+    return qasm;
+}
+
+namespace {
+/* phase of the |1> amplitude for the complex-only diagonal gates */
+std::complex<double> diagonal_phase(GateKind kind) {
+    switch (kind) {
+    case GateKind::T:
+        return std::exp(1i * M_PI / 4.0);
+    case GateKind::Tdg:
+        return std::exp(-1i * M_PI / 4.0);
+    case GateKind::S:
+        return 1i;
+    default:
+        return std::exp(-1i * M_PI / 2.0);
+    }
+}
+
+template <typename State> void apply_op(const GateList& list, const GateOp& op, State& state, const bool reverse) {
+    constexpr bool is_complex = std::is_same_v<State, QState>;
+    switch (op.kind) {
+    case GateKind::X:
+        apply_kernel(state, [&](auto& map, uint64_t* hash) { flip_pairs(map, op.target(), always, hash); });
+        break;
+    case GateKind::CX:
+    case GateKind::CCX: {
+        auto active = [&](index_t index) { return (index & op.ctrl_mask) == op.ctrl_value; };
+        apply_kernel(state, [&](auto& map, uint64_t* hash) { flip_pairs(map, op.target(), active, hash); });
+        break;
+    }
+    case GateKind::T:
+    case GateKind::Tdg:
+    case GateKind::S:
+    case GateKind::Sdg:
+        if constexpr (is_complex) {
+            const std::complex<double> phase = diagonal_phase(op.kind);
+            rotate_masked(state, op.target(),
+                          std::array<std::complex<double>, 4>{1.0, 0.0, 0.0, reverse ? std::conj(phase) : phase},
+                          op.ctrl_mask, op.ctrl_value);
+            break;
+        } else if (op.kind == GateKind::S) {
+            throw std::runtime_error("S gate not supported in real-amplitude QRState simulation");
+        } else if (op.kind == GateKind::Sdg) {
+            throw std::runtime_error("Sdg introduces complex phase; use QState simulation");
+        }
+        [[fallthrough]];
+    case GateKind::H:
+    case GateKind::Z:
+    case GateKind::RY:
+    case GateKind::CRY:
+    case GateKind::MCRY:
+    case GateKind::Unitary:
+        rotate_masked(state, op.target(), op.coef, op.ctrl_mask, op.ctrl_value, reverse);
+        break;
+    case GateKind::MCMY:
+    case GateKind::QROM_MCRY:
+        rotate_multiplexed(state, list.ctrls_of(op), op.target(), list.params_of(op), reverse);
+        break;
+    }
+}
+} // namespace
+
+void GateList::apply(const GateOp& op, QRState& state, const bool reverse) const {
+    apply_op(*this, op, state, reverse);
+}
+
+void GateList::apply(const GateOp& op, QState& state, const bool reverse) const {
+    apply_op(*this, op, state, reverse);
+}
+
+GateList decompose(const GateList& list) {
+    GateList out(list.num_qbits);
+    out.ops.reserve(list.size());
+    for (const auto& op : list.ops) {
+        if (op.kind == GateKind::CRY) {
+            out.add(GateKind::RY, op.target(), op.theta / 2);
+            out.add(GateKind::CX, op.qbits[1], true, op.target());
+            out.add(GateKind::RY, op.target(), op.phase ? -op.theta / 2 : op.theta / 2);
+            out.add(GateKind::CX, op.qbits[1], true, op.target());
+        } else if (op.kind == GateKind::CX && !op.phase) {
+            out.add(GateKind::X, op.qbits[1]);
+            out.add(GateKind::CX, op.qbits[1], true, op.target());
+            out.add(GateKind::X, op.qbits[1]);
+        } else {
+            out.append(list, op);
+        }
+    }
+    return out;
+}
+
+namespace {
+bool is_single_qubit(GateKind kind) {
+    switch (kind) {
+    case GateKind::X:
+    case GateKind::H:
+    case GateKind::Z:
+    case GateKind::T:
+    case GateKind::Tdg:
+    case GateKind::RY:
+    case GateKind::Unitary:
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::array<double, 4> coef_of(const GateOp& op) {
+    if (op.kind == GateKind::X)
+        return {0.0, 1.0, 1.0, 0.0};
+    return op.coef;
+}
+
+/* coefficients of b applied after a, in the {c00, c01, c10, c11} layout of rotate_masked */
+std::array<double, 4> compose(const std::array<double, 4>& a, const std::array<double, 4>& b) {
+    return {b[0] * a[0] + b[2] * a[1], b[1] * a[0] + b[3] * a[1], b[0] * a[2] + b[2] * a[3],
+            b[1] * a[2] + b[3] * a[3]};
+}
+
+bool is_diagonal(const std::array<double, 4>& c) {
+    return c[1] == 0.0 && c[2] == 0.0;
+}
+
+bool is_identity(const std::array<double, 4>& c) {
+    constexpr double tol = 1e-12;
+    return std::abs(c[0] - 1.0) < tol && std::abs(c[1]) < tol && std::abs(c[2]) < tol && std::abs(c[3] - 1.0) < tol;
+}
+} // namespace
+
+/* collapses runs of single-qubit gates per qubit into one Unitary; a diagonal run is carried
+ * across gates that only use its qubit as a control, since it commutes with them */
+GateList fuse(const GateList& list) {
+    struct Run {
+        uint32_t              count = 0;
+        std::size_t           first = 0;
+        std::array<double, 4> coef  = {1.0, 0.0, 0.0, 1.0};
+    };
+    GateList         out(list.num_qbits);
+    std::vector<Run> runs;
+    auto             flush = [&](uint32_t qubit) {
+        if (qubit >= runs.size() || runs[qubit].count == 0)
+            return;
+        Run& run = runs[qubit];
+        if (run.count == 1)
+            out.append(list, list.ops[run.first]);
+        else if (!is_identity(run.coef))
+            out.add_unitary(qubit, run.coef);
+        run = Run();
+    };
+
+    for (std::size_t i = 0; i < list.size(); i++) {
+        const GateOp& op = list.ops[i];
+        if (is_single_qubit(op.kind)) {
+            if (op.target() >= runs.size())
+                runs.resize(op.target() + 1);
+            Run& run = runs[op.target()];
+            if (run.count++ == 0)
+                run.first = i;
+            run.coef = compose(run.coef, coef_of(op));
+            continue;
+        }
+        flush(op.target());
+        for (uint32_t ctrl : list.ctrls_of(op))
+            if (ctrl < runs.size() && !is_diagonal(runs[ctrl].coef))
+                flush(ctrl);
+        out.append(list, op);
+    }
+    for (uint32_t qubit = 0; qubit < runs.size(); qubit++)
+        flush(qubit);
+    return out;
+}
+
+namespace {
+template <typename State>
+State simulate_with(const GateList& list, const State& state, const sim_params& params, sim_stats* stats) {
+    GateList        fused;
+    const GateList* run = &list;
+    /* fused coefficients are real, which would drop the T/Tdg phases of a complex state */
+    if (params.fuse && std::is_same_v<State, QRState>) {
+        fused = fuse(list);
+        run   = &fused;
+    }
+    const bool dense = params.engine == SimEngine::Dense ||
+                       (params.engine == SimEngine::Auto &&
+                        prefer_dense(*run, std::max(state.n_bits, run->num_qbits), state.index_to_weight.size(),
+                                     params.dense_max_bits));
+    if (stats) {
+        stats->num_gates  = list.size();
+        stats->num_passes = run->size();
+        stats->engine     = dense ? SimEngine::Dense : SimEngine::Sparse;
+    }
+    if (dense) {
+        if constexpr (std::is_same_v<State, QState>)
+            return simulate_dense(*run, state, params.n_threads, params.phase_run);
+        else
+            return simulate_dense(*run, state, params.n_threads);
+    }
+    State new_state = state;
+    for (std::size_t i = 0; i < run->size();) {
+        const std::size_t end = params.permute_run ? permutation_run_end(*run, i) : i;
+        if constexpr (std::is_same_v<State, QState>) {
+            const std::size_t phase_end = params.phase_run ? phase_run_end(*run, i) : i;
+            if (phase_end > end && phase_end - i >= std::max<std::size_t>(params.phase_run, 2)) {
+                const PhasePolynomial poly(*run, i, phase_end);
+                auto                  scale = [&](index_t index, const std::complex<double>& weight) {
+                    return weight * poly(index);
+                };
+                if (poly.permutes())
+                    relabel(new_state.index_to_weight, poly.permutation(), nullptr, scale);
+                else
+                    rescale(new_state.index_to_weight, scale);
+                if (stats)
+                    stats->num_passes -= (uint32_t)(phase_end - i - 1);
+                i = phase_end;
+                continue;
+            }
+        }
+        if (end - i < std::max<std::size_t>(params.permute_run, 2)) {
+            run->apply(run->ops[i++], new_state);
+            continue;
+        }
+        const IndexPermutation perm(*run, i, end);
+        apply_kernel(new_state, [&](auto& map, uint64_t* hash) { relabel(map, perm, hash); });
+        if (stats)
+            stats->num_passes -= (uint32_t)(end - i - 1);
+        i = end;
+    }
+    return new_state;
+}
+} // namespace
+
+QRState simulate(const GateList& list, const QRState& state, const sim_params& params, sim_stats* stats) {
+    return simulate_with(list, state, params, stats);
+}
+
+QRState simulate(const GateList& list, const QRState& state, bool verbose) {
+    if (!verbose)
+        return simulate_with(list, state, sim_params(), nullptr);
+    QRState new_state = state;
+    for (const auto& op : list.ops) {
+        std::cout << "Applying gate: " << list.to_string(op) << std::endl;
+        std::cout << "State before: " << new_state << std::endl;
+        list.apply(op, new_state);
+        std::cout << "State after: " << new_state << std::endl;
+        std::cout << "----------------------------------------" << std::endl;
+    }
+    return new_state;
+}
+
+QState simulate(const GateList& list, const QState& state, const sim_params& params, sim_stats* stats) {
+    return simulate_with(list, state, params, stats);
+}
+
+void write_qasm2(const GateList& list, const std::string& filename) {
+    std::ofstream file;
+    file.open(filename);
+    file << list.to_qasm2();
+    file.close();
+}
+
+} // namespace xyz
@@ -0,0 +1,60 @@
+#include "permutation.hpp"
+
+#include <algorithm>
+
+namespace xyz {
+
+std::size_t permutation_run_end(const GateList& list, std::size_t begin) {
+    std::size_t end = begin;
+    while (end < list.size() && is_permutation(list.ops[end].kind))
+        end++;
+    return end;
+}
+
+IndexPermutation::IndexPermutation(const GateList& list, std::size_t begin, std::size_t end) : n_gates(end - begin) {
+    uint32_t n      = 0;
+    bool     affine = true;
+    for (std::size_t i = begin; i < end; i++) {
+        const GateOp& op = list.ops[i];
+        flips.push_back({index_t(1) << op.target(), op.ctrl_mask, op.ctrl_value});
+        affine = affine && op.kind != GateKind::CCX;
+        for (uint8_t k = 0; k <= op.n_ctrls; k++)
+            n = std::max(n, op.qbits[k] + 1);
+    }
+    if (!affine)
+        return;
+
+    /* row j is the set of input bits XORed into output bit j */
+    std::vector<index_t> rows(n);
+    for (uint32_t j = 0; j < n; j++)
+        rows[j] = index_t(1) << j;
+    for (std::size_t i = begin; i < end; i++) {
+        const GateOp&  op = list.ops[i];
+        const uint32_t t  = op.target();
+        if (op.kind == GateKind::X) {
+            shift ^= index_t(1) << t;
+            continue;
+        }
+        const uint32_t c = op.qbits[1];
+        rows[t] ^= rows[c];
+        shift ^= (((shift >> c) & 1) ^ (op.phase ? 0 : 1)) << t;
+    }
+
+    low = index_mask(n);
+    tables.resize((n + 7) / 8);
+    for (std::size_t b = 0; b < tables.size(); b++) {
+        std::array<index_t, 8> cols{};
+        for (uint32_t k = 0; k < 8 && 8 * b + k < n; k++)
+            for (uint32_t j = 0; j < n; j++)
+                cols[k] |= ((rows[j] >> (8 * b + k)) & 1) << j;
+        auto& table = tables[b];
+        table[0]    = 0;
+        for (std::size_t v = 1; v < 256; v++) {
+            const uint32_t k = __builtin_ctz((unsigned)v);
+            table[v]         = table[v & (v - 1)] ^ cols[k];
+        }
+    }
+    flips.clear();
+}
+
+} // namespace xyz
@@ -0,0 +1,82 @@
+#include "phase-polynomial.hpp"
+
+#include <cmath>
+#include <map>
+
+namespace xyz {
+
+std::optional<uint32_t> phase_eighths(const GateOp& op) {
+    if (op.n_ctrls != 0)
+        return std::nullopt;
+    switch (op.kind) {
+    case GateKind::T:
+        return 1;
+    case GateKind::S:
+        return 2;
+    case GateKind::Z:
+        return 4;
+    case GateKind::Sdg:
+        return 6;
+    case GateKind::Tdg:
+        return 7;
+    default:
+        return std::nullopt;
+    }
+}
+
+std::size_t phase_run_end(const GateList& list, std::size_t begin) {
+    std::size_t end = begin;
+    while (end < list.size() &&
+           (phase_eighths(list.ops[end]) || list.ops[end].kind == GateKind::X || list.ops[end].kind == GateKind::CX))
+        end++;
+    return end;
+}
+
+PhasePolynomial::PhasePolynomial(const GateList& list, std::size_t begin, std::size_t end) : n_gates(end - begin) {
+    /* qubit q holds parity(rows[q] & x) ^ bit q of shift, for input index x */
+    std::vector<index_t>        rows;
+    index_t                     shift = 0;
+    GateList                    moves(list.num_qbits);
+    std::map<index_t, uint32_t> acc;
+    auto                        row = [&](uint32_t q) -> index_t& {
+        while (rows.size() <= q)
+            rows.push_back(index_t(1) << rows.size());
+        return rows[q];
+    };
+    for (std::size_t i = begin; i < end; i++) {
+        const GateOp&  op = list.ops[i];
+        const uint32_t t  = op.target();
+        if (auto k = phase_eighths(op)) {
+            /* w^(k (p ^ 1)) = w^k w^(-k p) */
+            if ((shift >> t) & 1) {
+                offset += *k;
+                acc[row(t)] += 8 - *k;
+            } else {
+                acc[row(t)] += *k;
+            }
+            continue;
+        }
+        moves.append(list, op);
+        if (op.kind == GateKind::X) {
+            shift ^= index_t(1) << t;
+            continue;
+        }
+        const uint32_t c    = op.qbits[1];
+        const index_t  from = row(c);
+        row(t) ^= from;
+        shift ^= (((shift >> c) & 1) ^ (op.phase ? 0 : 1)) << t;
+    }
+    offset &= 7;
+    for (const auto& [mask, k] : acc)
+        if (k & 7)
+            terms.emplace_back(mask, k & 7);
+    for (uint32_t k = 0; k < 8; k++)
+        turns[k] = std::polar(1.0, M_PI / 4.0 * k);
+    turns[2] = {0.0, 1.0};
+    turns[4] = {-1.0, 0.0};
+    turns[6] = {0.0, -1.0};
+    if (moves.size())
+        perm.emplace(moves, 0, moves.size());
+}
+
+} // namespace xyz
@@ -34,10 +34,10 @@ void prepare_auto_rec(const QRState& state, std::vector<std::shared_ptr<QGate>>&
         std::cout << "n=" << num_supports << " card=" << cardinality << "\n";
 
     if (cardinality == 1) {
-        uint32_t index = reduced_state.index_to_weight.begin()->first;
+        index_t index = reduced_state.index_to_weight.begin()->first;
         for (uint32_t qubit = 0; qubit < reduced_state.n_bits; qubit++)
             if ((index >> qubit) & 1)
-                support_reduction_gates.push_back(std::make_shared<X>(qubit));
+                support_reduction_gates.push_back(make_gate<X>(qubit));
         gates.insert(gates.end(), support_reduction_gates.begin(), support_reduction_gates.end());
         return;
     }
@@ -49,7 +49,9 @@ void prepare_auto_rec(const QRState& state, std::vector<std::shared_ptr<QGate>>&
     if (num_supports <= n_qubits_max && cardinality <= EXACT_SYNTHESIS_DENSITY_THRESHOLD) {
         QCircuit   circ(reduced_state.n_bits);
         bfs_params params;
-        bool       bfs_success = prepare_state_bfs(reduced_state, circ, params, false);
+        params.heuristic = entangled_qubit_bound;
+        params.canonical = true;
+        bool bfs_success = prepare_state_bfs(reduced_state, circ, params, false);
 
         if (bfs_success) {
             std::vector<std::shared_ptr<QGate>> exact_gates;
@@ -77,6 +79,7 @@ void prepare_auto_rec(const QRState& state, std::vector<std::shared_ptr<QGate>>&
 } // namespace
 
 QCircuit prepare_state_auto(const QRState& state, bool verbose) {
+    ArenaScope                          arena;
     QCircuit                            circuit(state.n_bits);
     std::vector<std::shared_ptr<QGate>> gates;
     prepare_auto_rec(state, gates, verbose);
@@ -1,34 +1,185 @@
 #include "qcircuit.hpp"
 #include "prepare-state.hpp"
+#include "thread-pool.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <queue>
+#include <stdexcept>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 namespace xyz {
 namespace {
+/* 128 bits of the quantized weights: repr() and an independent sum over the same terms */
+struct fingerprint {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+    bool     operator==(const fingerprint& other) const { return lo == other.lo && hi == other.hi; }
+};
+
+fingerprint fingerprint_of(const QRState& state) {
+    fingerprint key{state.repr(), splitmix64(~QRState::repr_seed(state.n_bits))};
+    state.index_to_weight.for_each([&](index_t index, double weight) {
+        if (uint64_t term = QRState::repr_term(index, weight))
+            key.hi += splitmix64(term ^ 0x9e3779b97f4a7c15ull);
+    });
+    key.hi |= 1; /* zero marks an empty slot */
+    return key;
+}
+
+/* the closed set and cost table of the search, as one open-addressing table over fingerprints; states with
+ * equal fingerprints are taken to be equal */
+class fingerprint_table {
+  public:
+    struct slot {
+        fingerprint key;
+        uint32_t    cost   = 0;
+        bool        closed = false;
+    };
+    fingerprint_table() : slots(64, slot(), state_resource()) {}
+    slot* find(const fingerprint& key) {
+        slot& s = probe(key);
+        return s.key.hi ? &s : nullptr;
+    }
+    slot& insert(const fingerprint& key) {
+        if (10 * (used + 1) > 7 * slots.size())
+            grow();
+        slot& s = probe(key);
+        if (!s.key.hi) {
+            s.key = key;
+            used++;
+        }
+        return s;
+    }
+
+  private:
+    slot& probe(const fingerprint& key) {
+        const std::size_t mask = slots.size() - 1;
+        for (std::size_t i = key.lo & mask;; i = (i + 1) & mask)
+            if (!slots[i].key.hi || slots[i].key == key)
+                return slots[i];
+    }
+    void grow() {
+        std::pmr::vector<slot> old(2 * slots.size(), slot(), state_resource());
+        old.swap(slots);
+        for (const auto& s : old)
+            if (s.key.hi)
+                probe(s.key) = s;
+    }
+    std::pmr::vector<slot> slots;
+    std::size_t            used = 0;
+};
+
+/* ordered by priority = cnot_cost + h, equal priorities by the deeper (larger cnot_cost) node first */
 struct bfs_state {
-    uint32_t mem_idx;
-    uint32_t cnot_cost;
-    uint32_t depth;
-    bool     operator<(const bfs_state& other) const { return cnot_cost > other.cnot_cost; }
-    bfs_state(uint32_t mem_idx, uint32_t cnot_cost, uint32_t depth)
-        : mem_idx(mem_idx), cnot_cost(cnot_cost), depth(depth) {}
+    uint32_t    node;
+    uint32_t    cnot_cost;
+    uint32_t    depth;
+    uint32_t    priority;
+    fingerprint key;
+    bool        goal;
+    bool        operator<(const bfs_state& other) const {
+        if (priority != other.priority)
+            return priority > other.priority;
+        return cnot_cost < other.cnot_cost;
+    }
+    bfs_state(uint32_t node, uint32_t cnot_cost, uint32_t depth, uint32_t priority, fingerprint key, bool goal)
+        : node(node), cnot_cost(cnot_cost), depth(depth), priority(priority), key(key), goal(goal) {}
+};
+
+/* exposes the heap so the parallel search can look at the nodes likely to be popped next */
+struct bfs_queue : std::priority_queue<bfs_state> {
+    const std::vector<bfs_state>& heap() const { return c; }
 };
 
-struct memorized_state {
-    uint32_t               prev;
-    QRState                state;
-    std::shared_ptr<QGate> gate;
-    memorized_state(const QRState& state, uint32_t prev) : prev(prev), state(state) {}
-    memorized_state(const QRState& state, uint32_t prev, std::shared_ptr<QGate> gate)
-        : prev(prev), state(state), gate(gate) {}
+/* a gate as the node table keeps it, or the perimeter completion of the parent state */
+/* qubits are below index_bits, which uint16_t always holds; the node stays 24 bytes */
+struct move {
+    enum kind_t : uint8_t { none, x, ry, cry, cx, perimeter };
+    double   theta  = 0.0;
+    kind_t   kind   = none;
+    bool     phase  = false;
+    uint16_t ctrl   = 0;
+    uint16_t target = 0;
 };
+static_assert(index_bits <= std::numeric_limits<uint16_t>::max() + 1, "move qubits must fit in uint16_t");
+
+move encode(const QGate& gate) {
+    GateList list;
+    gate.lower(list);
+    const GateOp& op = list.ops.front();
+    move          m;
+    m.target = (uint16_t)op.target();
+    switch (op.kind) {
+    case GateKind::X:
+        m.kind = move::x;
+        break;
+    case GateKind::RY:
+        m.kind  = move::ry;
+        m.theta = op.theta;
+        break;
+    case GateKind::CRY:
+        m.kind  = move::cry;
+        m.theta = op.theta;
+        m.ctrl  = (uint16_t)op.qbits[1];
+        m.phase = op.phase;
+        break;
+    case GateKind::CX:
+        m.kind  = move::cx;
+        m.ctrl  = (uint16_t)op.qbits[1];
+        m.phase = op.phase;
+        break;
+    default:
+        throw std::runtime_error("encode: unsupported gate " + gate.to_string());
+    }
+    return m;
+}
+
+std::shared_ptr<QGate> decode(const move& m) {
+    switch (m.kind) {
+    case move::x:
+        return make_gate<X>(m.target);
+    case move::ry:
+        return make_gate<RY>(m.target, m.theta);
+    case move::cry:
+        return make_gate<CRY>(m.ctrl, m.phase, m.theta, m.target);
+    case move::cx:
+        return make_gate<CX>(m.ctrl, m.phase, m.target);
+    default:
+        throw std::runtime_error("decode: not a gate");
+    }
+}
+
+/* a node keeps only its parent and the move from the parent's state; its state is regenerated by replaying */
+struct bfs_node {
+    uint32_t prev;
+    move     step;
+};
+
+/* the gate acting on the unrelabeled state the way gate acts on symmetry(state) */
+std::shared_ptr<QGate> conjugate(const std::shared_ptr<QGate>& gate, const state_symmetry& symmetry) {
+    if (symmetry.qubits.empty() && symmetry.flips == 0)
+        return gate;
+    std::vector<uint32_t> source(symmetry.qubits.size());
+    for (uint32_t q = 0; q < symmetry.qubits.size(); q++)
+        source[symmetry.qubits[q]] = q;
+    auto qubit   = [&](uint32_t j) { return source.empty() ? j : source[j]; };
+    auto flipped = [&](uint32_t j) { return (bool)((symmetry.flips >> qubit(j)) & 1); };
+    move m       = encode(*gate);
+    if (m.kind == move::cry || m.kind == move::cx) {
+        m.phase = m.phase != flipped(m.ctrl);
+        m.ctrl  = (uint16_t)qubit(m.ctrl);
+    }
+    if (flipped(m.target))
+        m.theta = -m.theta;
+    m.target = (uint16_t)qubit(m.target);
+    return decode(m);
+}
 
 std::vector<std::shared_ptr<QGate>> enumerate_gates(const QRState& state) {
     std::vector<std::shared_ptr<QGate>> gates;
@@ -36,7 +187,7 @@ std::vector<std::shared_ptr<QGate>> enumerate_gates(const QRState& state) {
         auto index = state.index_to_weight.begin()->first;
         for (uint32_t target = 0; target < state.n_bits; target++)
             if ((index >> target) & 1) {
-                gates.push_back(std::make_shared<X>(target));
+                gates.push_back(make_gate<X>(target));
                 return gates;
             }
     }
@@ -51,7 +202,7 @@ std::vector<std::shared_ptr<QGate>> enumerate_gates(const QRState& state) {
             theta = t;
         }
         if (theta.has_value() && !Rotation::is_trivial(theta.value(), true)) {
-            gates.push_back(std::make_shared<RY>(target, theta.value()));
+            gates.push_back(make_gate<RY>(target, theta.value()));
             return gates;
         }
     }
@@ -71,8 +222,8 @@ std::vector<std::shared_ptr<QGate>> enumerate_gates(const QRState& state) {
                         theta = t;
                     }
                 if (theta.has_value() && !Rotation::is_trivial(theta.value(), true)) {
-                    gates.push_back(std::make_shared<CRY>(ctrl, phase, theta.value(), target));
-                    gates.push_back(std::make_shared<CRY>(ctrl, phase, -M_PI + theta.value(), target));
+                    gates.push_back(make_gate<CRY>(ctrl, phase, theta.value(), target));
+                    gates.push_back(make_gate<CRY>(ctrl, phase, -M_PI + theta.value(), target));
                 }
             }
     }
@@ -80,55 +231,279 @@ std::vector<std::shared_ptr<QGate>> enumerate_gates(const QRState& state) {
         for (uint32_t ctrl = 0; ctrl < state.n_bits; ctrl++) {
             if (ctrl == target)
                 continue;
-            gates.push_back(std::make_shared<CX>(ctrl, true, target));
+            gates.push_back(make_gate<CX>(ctrl, true, target));
         }
     return gates;
 }
 
-bool prepare_state_impl(const QRState& state, QCircuit& circuit, const bfs_params& params, bool verbose) {
-    std::priority_queue<bfs_state>                     q;
-    std::vector<memorized_state>                       states;
-    std::unordered_map<QRState, uint32_t, QRStateHash> cost;
-    std::unordered_set<QRState, QRStateHash>           visited;
-    std::optional<uint32_t>                            solution;
+/* qubits that do not factor out of the state: a qubit factors out iff every pair has the same angle, where
+ * angles 2 pi apart differ only by a sign that the rest of the state absorbs */
+std::vector<uint32_t> entangled_qubits(const QRState& state) {
+    std::vector<uint32_t> entangled;
+    for (uint32_t target = 0; target < state.n_bits; target++) {
+        std::optional<double> theta;
+        for (const auto& [index, t] : state.to_ry_table(target)) {
+            if (!theta.has_value()) {
+                theta = t;
+                continue;
+            }
+            if (std::abs(std::remainder(t - theta.value(), 2 * M_PI)) > QRState::eps) {
+                entangled.push_back(target);
+                break;
+            }
+        }
+    }
+    return entangled;
+}
+
+/* zero-CNOT moves taking a product state to the ground state, or nullopt if the greedy moves get stuck */
+std::optional<std::vector<std::shared_ptr<QGate>>> finish_product(QRState state) {
+    std::vector<std::shared_ptr<QGate>> path;
+    for (uint32_t step = 0; step <= 2 * state.n_bits && !state.is_ground(); step++) {
+        auto gates = enumerate_gates(state);
+        auto it    = std::find_if(gates.begin(), gates.end(), [](const auto& g) { return g->num_cnots() == 0; });
+        if (it == gates.end())
+            return std::nullopt;
+        state = (**it)(state, true);
+        path.push_back(*it);
+    }
+    if (!state.is_ground())
+        return std::nullopt;
+    return path;
+}
+
+/* the ground-side frontier in closed form: moves to the ground state from a product state (0 CNOTs) or from
+ * a CX away from one (1 CNOT), or nullopt outside that perimeter. A CX changes whether only its own two
+ * qubits factor out, so the second case needs exactly two entangled qubits and a CX between them. Any
+ * completion found has the exact remaining cost, since an entangled state needs at least one CNOT */
+std::optional<std::vector<std::shared_ptr<QGate>>> perimeter_path(const QRState& state) {
+    std::vector<uint32_t> entangled = entangled_qubits(state);
+    if (entangled.empty())
+        return finish_product(state);
+    if (entangled.size() != 2)
+        return std::nullopt;
+    for (auto [ctrl, target] : {std::pair(entangled[0], entangled[1]), std::pair(entangled[1], entangled[0])}) {
+        auto          cx   = make_gate<CX>(ctrl, true, target);
+        const QRState next = (*cx)(state, true);
+        if (!entangled_qubits(next).empty())
+            continue;
+        if (auto path = finish_product(next)) {
+            path->insert(path->begin(), cx);
+            return path;
+        }
+    }
+    return std::nullopt;
+}
 
-    states.push_back(memorized_state(state, (uint32_t)-1));
-    q.push(bfs_state(0, 0, 0));
-    cost[state] = 0;
+/* the moves out of a node and their results, canonical if asked; a pure function of the state, so nodes can
+ * be expanded on any thread ahead of the serial loop, which then consumes them in its own order. h is filled
+ * only ahead of time */
+struct expansion {
+    std::vector<std::shared_ptr<QGate>> gates;
+    std::vector<QRState>                children;
+    std::vector<fingerprint>            keys;
+    std::vector<uint32_t>               h;
+    bool                                truncated = false;
+};
+
+expansion expand(const QRState& state, const bfs_params& params) {
+    expansion ex;
+    ex.gates = enumerate_gates(state);
+    if (ex.gates.size() > params.max_neighbors) {
+        std::sort(ex.gates.begin(), ex.gates.end(),
+                  [](const auto& a, const auto& b) { return a->num_cnots() < b->num_cnots(); });
+        ex.gates.resize(params.max_neighbors);
+        ex.truncated = true;
+    }
+    ex.children.reserve(ex.gates.size());
+    ex.keys.reserve(ex.gates.size());
+    for (const auto& gate : ex.gates) {
+        ex.children.push_back((*gate)(state, true));
+        if (params.canonical)
+            ex.children.back() = canonical_state(ex.children.back());
+        ex.keys.push_back(fingerprint_of(ex.children.back()));
+    }
+    return ex;
+}
+
+/* the state a move leads to, as expand() computes it, with the gates taken and the symmetry to the
+ * canonical form */
+QRState advance(const QRState& state, const move& step, const bfs_params& params,
+                std::vector<std::shared_ptr<QGate>>* gates = nullptr, state_symmetry* symmetry = nullptr) {
+    std::vector<std::shared_ptr<QGate>> path;
+    if (step.kind == move::perimeter)
+        path = perimeter_path(state).value();
+    else
+        path.push_back(decode(step));
+    QRState next = state;
+    for (const auto& gate : path)
+        next = (*gate)(next, true);
+    if (gates)
+        gates->insert(gates->end(), path.begin(), path.end());
+    if (params.canonical && step.kind != move::perimeter)
+        next = canonical_state(next, symmetry);
+    return next;
+}
+
+
+bool prepare_state_impl(const QRState& state, QCircuit& circuit, const bfs_params& params, bool verbose,
+                        bfs_stats* stats) {
+    ArenaScope                            arena;
+    bfs_queue                             q;
+    std::pmr::vector<bfs_node>            nodes(state_resource());
+    fingerprint_table                     table;
+    std::unordered_map<uint32_t, QRState> recent, older;
+    std::optional<bfs_state>              solution;
+    bfs_stats                             local;
+    bfs_stats&                            st = stats ? *stats : local;
+
+    bool truncated = false, capped = false;
+    auto h         = [&](const QRState& s) { return params.heuristic ? params.heuristic(s) : 0u; };
+
+    /* a node's state is replayed from the nearest ancestor that is the root or among the last expanded
+     * states, kept in two generations of cache_limit; they are only written on the calling thread */
+    const QRState     root        = params.canonical ? canonical_state(state) : state;
+    const std::size_t cache_limit = 4096;
+    auto              cached      = [&](uint32_t node) -> const QRState* {
+        if (node == 0)
+            return &root;
+        for (const auto* generation : {&recent, &older})
+            if (auto it = generation->find(node); it != generation->end())
+                return &it->second;
+        return nullptr;
+    };
+    auto replay = [&](uint32_t node) {
+        std::vector<uint32_t> chain;
+        const QRState*        from;
+        while (!(from = cached(node))) {
+            chain.push_back(node);
+            node = nodes[node].prev;
+        }
+        QRState s = *from;
+        for (auto c = chain.rbegin(); c != chain.rend(); ++c)
+            s = advance(s, nodes[*c].step, params);
+        return s;
+    };
+    auto remember = [&](uint32_t node, const QRState& s) {
+        if (recent.size() >= cache_limit) {
+            older = std::move(recent);
+            recent.clear();
+        }
+        recent.emplace(node, s);
+    };
+    auto closed = [&](const fingerprint& key) {
+        auto* slot = table.find(key);
+        return slot && slot->closed;
+    };
+
+    /* with several threads the nodes nearest the top of the heap are expanded together whenever the loop
+     * needs an expansion it does not have yet; everything else stays serial, so the result is unchanged.
+     * An expansion kept ahead is dropped when its node is popped, and at most ahead_limit are kept */
+    std::unique_ptr<ThreadPool>             own;
+    ThreadPool*                             pool = params.n_threads == 1 ? nullptr : &pool_for(params.n_threads, own);
+    std::unordered_map<uint32_t, expansion> ahead;
+    const std::size_t                       ahead_limit = pool ? 16 * pool->size() : 0;
+    auto expansion_of = [&](const bfs_state& e, const QRState& cur) {
+        if (!pool || pool->size() == 1)
+            return expand(cur, params);
+        if (auto it = ahead.find(e.node); it != ahead.end()) {
+            expansion ex = std::move(it->second);
+            ahead.erase(it);
+            return ex;
+        }
+        /* the best nodes sit in the first levels of the heap, though not in order */
+        const auto&            heap = q.heap();
+        std::vector<bfs_state> front(heap.begin(), heap.begin() + std::min<std::size_t>(heap.size(), 64));
+        std::sort(front.begin(), front.end(), [](const auto& a, const auto& b) { return b < a; });
+        std::vector<uint32_t> batch{e.node};
+        for (const auto& next : front) {
+            if (batch.size() >= 2 * pool->size() || ahead.size() + batch.size() > ahead_limit)
+                break;
+            if (!next.goal && next.depth < params.max_depth && !ahead.count(next.node) && !closed(next.key))
+                batch.push_back(next.node);
+        }
+        std::vector<expansion> done(batch.size());
+        pool->run((uint32_t)batch.size(), [&](uint32_t k) {
+            done[k] = expand(k == 0 ? cur : replay(batch[k]), params);
+            for (const auto& child : done[k].children)
+                done[k].h.push_back(h(child));
+        });
+        for (std::size_t k = 1; k < batch.size(); k++)
+            ahead.emplace(batch[k], std::move(done[k]));
+        return std::move(done[0]);
+    };
+
+    st = bfs_stats();
+    const fingerprint root_key = fingerprint_of(root);
+    nodes.push_back(bfs_node{(uint32_t)-1, move()});
+    table.insert(root_key).cost = 0;
+    q.push(bfs_state(0, 0, 0, h(root), root_key, root.is_ground()));
 
     while (!q.empty()) {
         auto e = q.top();
         q.pop();
-        auto cur = states[e.mem_idx];
-        if (visited.find(cur.state) != visited.end())
+        auto& slot = *table.find(e.key);
+        if (slot.closed) {
+            ahead.erase(e.node);
             continue;
-        visited.insert(cur.state);
-        if (cur.state.is_ground()) {
-            solution = e.mem_idx;
+        }
+        slot.closed = true;
+        if (e.goal) {
+            solution = e;
             break;
         }
-        if (e.depth >= params.max_depth)
+        if (e.depth >= params.max_depth) {
+            capped = true;
             continue;
-        if (verbose)
-            std::cout << "current_state: " << cur.state.to_string() << "\n";
-        auto gates = enumerate_gates(cur.state);
-        if (gates.size() > params.max_neighbors) {
-            std::sort(gates.begin(), gates.end(),
-                      [](const auto& a, const auto& b) { return a->num_cnots() < b->num_cnots(); });
-            gates.resize(params.max_neighbors);
         }
-        for (const auto& gate : gates) {
+        const QRState cur = replay(e.node);
+        if (params.perimeter) {
+            if (auto path = perimeter_path(cur)) {
+                /* queue the finished circuit as a goal node instead of expanding */
+                uint32_t total = e.cnot_cost;
+                QRState  s     = cur;
+                for (const auto& gate : *path) {
+                    s = (*gate)(s, true);
+                    total += gate->num_cnots();
+                }
+                const fingerprint key  = fingerprint_of(s);
+                auto*             goal = table.find(key);
+                if (!goal || goal->cost > total) {
+                    table.insert(key).cost = total;
+                    move step;
+                    step.kind = move::perimeter;
+                    nodes.push_back(bfs_node{e.node, step});
+                    q.push(bfs_state((uint32_t)nodes.size() - 1, total, e.depth + (uint32_t)path->size(), total, key,
+                                     true));
+                }
+                ahead.erase(e.node);
+                continue;
+            }
+        }
+        st.num_expanded++;
+        if (verbose)
+            std::cout << "current_state: " << cur.to_string() << "\n";
+        expansion ex = expansion_of(e, cur);
+        truncated    = truncated || ex.truncated;
+        remember(e.node, cur);
+        for (std::size_t k = 0; k < ex.gates.size(); k++) {
+            const auto& gate = ex.gates[k];
             if (verbose)
                 std::cout << "gate: " << *gate << "\n";
-            auto new_state = (*gate)(cur.state, true);
-            auto new_cost  = e.cnot_cost + gate->num_cnots();
-            if (visited.find(new_state) != visited.end())
+            auto new_cost = e.cnot_cost + gate->num_cnots();
+            auto it       = table.find(ex.keys[k]);
+            if (it && it->closed)
                 continue;
-            auto it = cost.find(new_state);
-            if (it == cost.end() || it->second > e.cnot_cost + 1) {
-                cost[new_state] = new_cost;
-                q.push(bfs_state((uint32_t)states.size(), new_cost, e.depth + 1));
-                states.push_back(memorized_state(new_state, e.mem_idx, gate));
+            /* the uniform-cost search keeps its historical reopening rule so its circuits stay reproducible;
+             * A* needs every strict improvement to be reopened for its guarantee */
+            auto reopen = params.heuristic ? new_cost : e.cnot_cost + 1;
+            if (!it || it->cost > reopen) {
+                table.insert(ex.keys[k]).cost = new_cost;
+                const uint32_t bound          = ex.h.empty() ? h(ex.children[k]) : ex.h[k];
+                nodes.push_back(bfs_node{e.node, encode(*gate)});
+                q.push(bfs_state((uint32_t)nodes.size() - 1, new_cost, e.depth + 1, new_cost + bound, ex.keys[k],
+                                 ex.children[k].is_ground()));
+                st.num_generated++;
             }
         }
     }
@@ -136,20 +511,46 @@ bool prepare_state_impl(const QRState& state, QCircuit& circuit, const bfs_param
     if (!solution.has_value())
         return false;
 
-    for (uint32_t idx = solution.value(); idx != 0; idx = states[idx].prev)
-        circuit.add_gate(states[idx].gate);
+    /* replay the path from the input state, mapping each gate back through the symmetries taken before it;
+     * the ground state a canonical path ends on is then the basis state of the remaining flips */
+    std::vector<uint32_t> path;
+    for (uint32_t idx = solution->node; idx != 0; idx = nodes[idx].prev)
+        path.push_back(idx);
+    std::vector<std::shared_ptr<QGate>> gates;
+    state_symmetry                      frame;
+    QRState                             cur = params.canonical ? canonical_state(state, &frame) : state;
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        std::vector<std::shared_ptr<QGate>> step;
+        state_symmetry                      symmetry;
+        cur = advance(cur, nodes[*it].step, params, &step, &symmetry);
+        for (const auto& gate : step)
+            gates.push_back(conjugate(gate, frame));
+        frame = frame.then(symmetry, state.n_bits);
+    }
+    for (uint32_t qubit = 0; qubit < state.n_bits; qubit++)
+        if ((frame.flips >> qubit) & 1)
+            circuit.add_gate(make_gate<X>(qubit));
+    for (auto it = gates.rbegin(); it != gates.rend(); ++it)
+        circuit.add_gate(*it);
+    st.cnot_cost = table.find(solution->key)->cost;
+    st.optimal   = params.heuristic && !truncated && !capped;
     return true;
 }
 } // namespace
 
-bool prepare_state_bfs(const QRState& state, QCircuit& circuit, const bfs_params& params, bool verbose) {
-    return prepare_state_impl(state, circuit, params, verbose);
+uint32_t entangled_qubit_bound(const QRState& state) {
+    return ((uint32_t)entangled_qubits(state).size() + 1) / 2;
+}
+
+bool prepare_state_bfs(const QRState& state, QCircuit& circuit, const bfs_params& params, bool verbose,
+                       bfs_stats* stats) {
+    return prepare_state_impl(state, circuit, params, verbose, stats);
 }
 
 QCircuit prepare_state(const QRState& state, bool verbose) {
     QCircuit   circuit(state.n_bits);
     bfs_params params;
-    prepare_state_impl(state, circuit, params, verbose);
+    prepare_state_impl(state, circuit, params, verbose, nullptr);
     return circuit;
 }
 
@@ -18,68 +18,68 @@ ReductionResult ry_reduction(const QRState& input_state) {
     for (uint32_t qubit_index = 0; qubit_index < state.n_bits; qubit_index++) {
         auto theta = state.get_ap_ry_angles(qubit_index);
         if (theta.has_value()) {
-            auto ry_gate = std::make_shared<RY>(qubit_index, theta.value());
+            auto ry_gate = make_gate<RY>(qubit_index, theta.value());
             gates.push_back(ry_gate);
-            state = (*ry_gate)(state, true);
+            ry_gate->apply(state, true);
         }
     }
     return {state, gates};
 }
 
 ReductionResult x_reduction(const QRState& input_state, bool enable_cnot) {
-    auto                                   signatures = input_state.get_qubit_signatures();
-    auto                                   const1     = input_state.get_const1_signature();
-    std::unordered_map<uint64_t, uint32_t> signature_to_qubits;
-    QRState                                state = input_state;
-    std::vector<std::shared_ptr<QGate>>    gates;
+    auto                                                   signatures = input_state.get_qubit_signatures();
+    auto                                                   const1     = input_state.get_const1_signature();
+    std::unordered_map<Signature, uint32_t, SignatureHash> signature_to_qubits;
+    QRState                                                state = input_state;
+    std::vector<std::shared_ptr<QGate>>                    gates;
     for (uint32_t qubit_index = 0; qubit_index < signatures.size(); qubit_index++) {
-        uint64_t signature = signatures[qubit_index];
-        if (signature == 0) {
+        const Signature& signature = signatures[qubit_index];
+        if (signature.none()) {
             continue;
         }
         if (signature == const1) {
-            auto x_gate = std::make_shared<X>(qubit_index);
+            auto x_gate = make_gate<X>(qubit_index);
             gates.push_back(x_gate);
-            state = (*x_gate)(state, false);
+            x_gate->apply(state, false);
             continue;
         }
         if (enable_cnot && signature_to_qubits.find(signature) != signature_to_qubits.end()) {
             uint32_t control_qubit = signature_to_qubits[signature];
-            auto     cx_gate       = std::make_shared<CX>(control_qubit, true, qubit_index);
+            auto     cx_gate       = make_gate<CX>(control_qubit, true, qubit_index);
             gates.push_back(cx_gate);
-            state = (*cx_gate)(state, false);
+            cx_gate->apply(state, false);
             continue;
         }
         if (enable_cnot && signature_to_qubits.find(signature ^ const1) != signature_to_qubits.end()) {
             uint32_t control_qubit = signature_to_qubits[signature ^ const1];
-            auto     cx_gate       = std::make_shared<CX>(control_qubit, false, qubit_index);
+            auto     cx_gate       = make_gate<CX>(control_qubit, false, qubit_index);
             gates.push_back(cx_gate);
-            state = (*cx_gate)(state, false);
+            cx_gate->apply(state, false);
             continue;
         }
         if (enable_cnot) {
             bool found = false;
             for (uint32_t q2 = qubit_index + 1; q2 < signatures.size(); q2++) {
-                uint64_t sig2 = signatures[q2];
+                const Signature& sig2 = signatures[q2];
                 if (signature_to_qubits.find(sig2 ^ signature) != signature_to_qubits.end()) {
                     uint32_t ctrl = signature_to_qubits[sig2 ^ signature];
-                    auto     cx1  = std::make_shared<CX>(ctrl, true, q2);
+                    auto     cx1  = make_gate<CX>(ctrl, true, q2);
                     gates.push_back(cx1);
-                    state    = (*cx1)(state, false);
-                    auto cx2 = std::make_shared<CX>(q2, true, qubit_index);
+                    cx1->apply(state, false);
+                    auto cx2 = make_gate<CX>(q2, true, qubit_index);
                     gates.push_back(cx2);
-                    state = (*cx2)(state, false);
+                    cx2->apply(state, false);
                     found = true;
                     break;
                 }
                 if (signature_to_qubits.find(sig2 ^ const1 ^ signature) != signature_to_qubits.end()) {
                     uint32_t ctrl = signature_to_qubits[sig2 ^ const1 ^ signature];
-                    auto     cx1  = std::make_shared<CX>(ctrl, true, q2);
+                    auto     cx1  = make_gate<CX>(ctrl, true, q2);
                     gates.push_back(cx1);
-                    state    = (*cx1)(state, false);
-                    auto cx2 = std::make_shared<CX>(q2, false, qubit_index);
+                    cx1->apply(state, false);
+                    auto cx2 = make_gate<CX>(q2, false, qubit_index);
                     gates.push_back(cx2);
-                    state = (*cx2)(state, false);
+                    cx2->apply(state, false);
                     found = true;
                     break;
                 }
@@ -95,11 +95,11 @@ ReductionResult x_reduction(const QRState& input_state, bool enable_cnot) {
 
 std::shared_ptr<QGate> conjugate_gate(const std::shared_ptr<QGate>& gate) {
     if (auto ry = std::dynamic_pointer_cast<RY>(gate)) {
-        return std::make_shared<RY>(ry->target, -ry->theta);
+        return make_gate<RY>(ry->target, -ry->theta);
     } else if (auto cry = std::dynamic_pointer_cast<CRY>(gate)) {
-        return std::make_shared<CRY>(cry->ctrl, cry->phase, -cry->theta, cry->target);
+        return make_gate<CRY>(cry->ctrl, cry->phase, -cry->theta, cry->target);
     } else if (auto mcry = std::dynamic_pointer_cast<MCRY>(gate)) {
-        return std::make_shared<MCRY>(mcry->ctrls, mcry->phases, -mcry->theta, mcry->target);
+        return make_gate<MCRY>(mcry->ctrls, mcry->phases, -mcry->theta, mcry->target);
     }
     return gate;
 }
@@ -111,13 +111,14 @@ uint32_t select_informative_qubit(const QRState& state, const std::vector<uint32
 
     assert(length >= 2);
 
+    std::vector<uint32_t> lengths1(state.n_bits, 0);
+    state.index_to_weight.for_each([&](index_t index, double) {
+        for (uint32_t qubit : supports)
+            lengths1[qubit] += (index >> qubit) & 1u;
+    });
+
     for (uint32_t qubit : supports) {
-        uint32_t length0 = 0;
-        for (const auto& [index, weight] : state.index_to_weight) {
-            if ((index & (1u << qubit)) == 0) {
-                length0++;
-            }
-        }
+        uint32_t length0 = length - lengths1[qubit];
 
         uint32_t difference = abs((int)length - 2 * (int)length0);
         if (difference < min_difference) {
@@ -195,20 +196,14 @@ ReductionResult qubit_reduction_by_one(const QRState& state) {
 
     std::vector<std::pair<double, double>> rotation_table(1u << control_indices.size(), {0.0, 0.0});
 
-    for (const auto& [index, weight] : state.index_to_weight) {
-        uint32_t rotation_index = 0;
-        for (uint32_t i = 0; i < control_indices.size(); i++) {
-            if (index & (1u << control_indices[i])) {
-                rotation_index |= 1u << i;
-            }
-        }
-
-        if (index & (1u << pivot)) {
+    state.index_to_weight.for_each([&](index_t index, double weight) {
+        uint32_t rotation_index = gather_bits(index, control_indices);
+        if ((index >> pivot) & 1u) {
             rotation_table[rotation_index].second += weight;
         } else {
             rotation_table[rotation_index].first += weight;
         }
-    }
+    });
 
     std::vector<double> rotation_angles;
     for (const auto& entry : rotation_table) {
@@ -227,46 +222,33 @@ ReductionResult qubit_reduction_by_one(const QRState& state) {
     std::shared_ptr<QGate>              gate;
 
     if (optimized_angles.size() == 1) {
-        gate = std::make_shared<RY>(pivot, optimized_angles[0]);
+        gate = make_gate<RY>(pivot, optimized_angles[0]);
     } else {
         std::vector<bool> phases(optimized_controls.size(), true);
-        gate = std::make_shared<MCMY>(optimized_controls, phases, optimized_angles, pivot);
+        gate = make_gate<MCMY>(optimized_controls, phases, optimized_angles, pivot);
     }
     gates.push_back(gate);
 
-    std::map<uint32_t, double>   new_weights;
-    std::unordered_set<uint32_t> processed;
-
-    for (const auto& [index, weight] : state.index_to_weight) {
-        if (processed.find(index) != processed.end()) {
-            continue;
-        }
-
-        uint32_t idx0         = index & ~(1u << pivot);
-        uint32_t idx1         = index | (1u << pivot);
-        uint32_t reversed_idx = index ^ (1u << pivot);
-
-        if (state.index_to_weight.find(reversed_idx) == state.index_to_weight.end()) {
-            new_weights[idx0] = weight;
-        } else {
-            double weight0       = state.index_to_weight.at(idx0);
-            double weight1       = state.index_to_weight.at(idx1);
-            double merged_weight = std::sqrt(weight0 * weight0 + weight1 * weight1);
-            new_weights[idx0]    = merged_weight;
-            processed.insert(idx1);
-        }
-        processed.insert(index);
-    }
-
-    for (auto it = new_weights.begin(); it != new_weights.end();) {
-        if (std::abs(it->second) < QRState::eps) {
-            it = new_weights.erase(it);
+    WeightMap<double> new_weights;
+    if (state.is_dense())
+        new_weights.make_dense(state.n_bits);
+    for_each_pair(state.index_to_weight, pivot, [&](index_t idx0, const double* weight0, const double* weight1) {
+        double merged_weight = weight0 ? *weight0 : *weight1;
+        if (weight0 && weight1)
+            merged_weight = std::sqrt(*weight0 * *weight0 + *weight1 * *weight1);
+        if (std::abs(merged_weight) < QRState::eps)
+            return;
+        if (new_weights.is_dense()) {
+            auto& out                    = new_weights.edit();
+            out.dense[(std::size_t)idx0] = merged_weight;
+            out.dense_size++;
         } else {
-            ++it;
+            new_weights.push_back(idx0, merged_weight);
         }
-    }
+    });
 
-    QRState reduced_state(new_weights, state.n_bits);
+    QRState reduced_state(std::move(new_weights), state.n_bits);
+    reduced_state.update_storage();
 
     return {reduced_state, gates};
 }
@@ -276,6 +258,7 @@ ReductionResult qubit_reduction_by_one(const QRState& state) {
 QCircuit prepare_state_dense(const QRState& state) {
     QCircuit circuit(state.n_bits);
     QRState  curr_state = state.clone();
+    curr_state.update_storage();
 
     std::vector<uint32_t> supports = curr_state.get_supports();
     while (supports.size() > 1) {
@@ -288,12 +271,12 @@ QCircuit prepare_state_dense(const QRState& state) {
     }
 
     if (curr_state.cardinality() == 1) {
-        uint32_t index     = curr_state.index_to_weight.begin()->first;
+        index_t  index     = curr_state.index_to_weight.begin()->first;
         bool     is_ground = (index == 0 && std::abs(curr_state.index_to_weight.at(0) - 1.0) < 1e-6);
         if (!is_ground) {
             for (uint32_t target = 0; target < curr_state.n_bits; target++) {
                 if ((index >> target) & 1) {
-                    circuit.add_gate(std::make_shared<X>(target));
+                    circuit.add_gate(make_gate<X>(target));
                 }
             }
         }
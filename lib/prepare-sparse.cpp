@@ -11,14 +11,15 @@
 namespace xyz {
 namespace {
 
-std::pair<uint32_t, uint32_t> maximize_difference_once(uint32_t num_qubits, std::unordered_set<uint32_t>& indices,
-                                                       std::unordered_map<uint32_t, bool>& diff_values) {
-    int                          max_diff = -1;
-    std::unordered_set<uint32_t> max_diff_indices_1;
-    uint32_t                     max_diff_qubit = 0;
-    uint32_t                     max_diff_value = false;
-    uint32_t                     length         = (uint32_t)indices.size();
-    std::unordered_set<uint32_t> indices_1;
+std::pair<uint32_t, uint32_t> maximize_difference_once(uint32_t                                num_qubits,
+                                                       std::unordered_set<index_t, IndexHash>& indices,
+                                                       std::unordered_map<uint32_t, bool>&     diff_values) {
+    int                                    max_diff = -1;
+    std::unordered_set<index_t, IndexHash> max_diff_indices_1;
+    uint32_t                               max_diff_qubit = 0;
+    uint32_t                               max_diff_value = false;
+    uint32_t                               length         = (uint32_t)indices.size();
+    std::unordered_set<index_t, IndexHash> indices_1;
 
     for (uint32_t qubit = 0; qubit < num_qubits; qubit++) {
         if (diff_values.find(qubit) != diff_values.end())
@@ -54,8 +55,8 @@ std::pair<uint32_t, uint32_t> maximize_difference_once(uint32_t num_qubits, std:
 } // namespace
 
 ReductionResult cardinality_reduction_by_one(const QRState& state) {
-    QRState                      new_state = state.clone();
-    std::unordered_set<uint32_t> indices;
+    QRState                                new_state = state.clone();
+    std::unordered_set<index_t, IndexHash> indices;
     for (auto [index, weight] : state.index_to_weight)
         indices.insert(index);
 
@@ -64,26 +65,25 @@ ReductionResult cardinality_reduction_by_one(const QRState& state) {
     while (indices.size() > 1)
         std::tie(diff_qubit, diff_value) = maximize_difference_once(state.n_bits, indices, diff_values);
 
-    uint32_t index0 = *indices.begin();
+    index_t index0 = *indices.begin();
     diff_values.erase(diff_qubit);
 
-    std::unordered_set<uint32_t> candidates;
+    index_t ctrl_mask = 0, ctrl_value = 0;
+    for (auto [qubit, value] : diff_values) {
+        ctrl_mask |= index_t(1) << qubit;
+        if (value)
+            ctrl_value |= index_t(1) << qubit;
+    }
+
+    std::unordered_set<index_t, IndexHash> candidates;
     for (auto [index, weight] : state.index_to_weight) {
-        if (indices.find(index) != indices.end())
-            continue;
-        bool valid = true;
-        for (auto [qubit, value] : diff_values)
-            if (((index >> qubit) & 1u) != (uint32_t)value) {
-                valid = false;
-                break;
-            }
-        if (valid)
+        if ((index & ctrl_mask) == ctrl_value && indices.find(index) == indices.end())
             candidates.insert(index);
     }
     while (candidates.size() > 1)
         (void)maximize_difference_once(state.n_bits, candidates, diff_values);
 
-    uint32_t                            index1 = *candidates.begin();
+    index_t                             index1 = *candidates.begin();
     std::vector<std::shared_ptr<QGate>> gates;
 
     for (uint32_t qubit = 0; qubit < state.n_bits; qubit++) {
@@ -91,9 +91,9 @@ ReductionResult cardinality_reduction_by_one(const QRState& state) {
             continue;
         if (qubit == diff_qubit)
             continue;
-        auto gate = std::make_shared<CX>(diff_qubit, diff_value, qubit);
+        auto gate = make_gate<CX>(diff_qubit, diff_value, qubit);
         gates.push_back(gate);
-        new_state = (*gate)(new_state, true);
+        gate->apply(new_state, true);
     }
 
     std::vector<uint32_t> ctrls;
@@ -103,19 +103,19 @@ ReductionResult cardinality_reduction_by_one(const QRState& state) {
         phases.push_back(value);
     }
 
-    uint32_t idx0 = index1 & (~(1u << diff_qubit));
-    uint32_t idx1 = index1 | (1u << diff_qubit);
-    auto     it0  = new_state.index_to_weight.find(idx0);
-    auto     it1  = new_state.index_to_weight.find(idx1);
+    index_t idx0 = index1 & (~(index_t(1) << diff_qubit));
+    index_t idx1 = index1 | (index_t(1) << diff_qubit);
+    auto    it0  = new_state.index_to_weight.find(idx0);
+    auto    it1  = new_state.index_to_weight.find(idx1);
     assert(it0 != new_state.index_to_weight.end());
     assert(it1 != new_state.index_to_weight.end());
 
     double theta = 2.0 * atan2l((long double)it1->second, (long double)it0->second);
-    if (index1 & (1u << diff_qubit))
+    if ((index1 >> diff_qubit) & 1u)
         theta = -M_PI + theta;
-    auto mcry_gate = std::make_shared<MCRY>(ctrls, phases, theta, diff_qubit);
+    auto mcry_gate = make_gate<MCRY>(ctrls, phases, theta, diff_qubit);
     gates.push_back(mcry_gate);
-    new_state = (*mcry_gate)(new_state, true);
+    mcry_gate->apply(new_state, true);
 
     std::reverse(gates.begin(), gates.end());
     return {new_state, gates};
@@ -130,10 +130,10 @@ QCircuit prepare_sparse_state(const QRState& state) {
             circuit.add_gate(gate);
         curr_state = result.state;
     }
-    uint32_t index = curr_state.index_to_weight.begin()->first;
+    index_t index = curr_state.index_to_weight.begin()->first;
     for (uint32_t qubit = 0; qubit < state.n_bits; qubit++)
         if ((index >> qubit) & 1u)
-            circuit.add_gate(std::make_shared<X>(qubit));
+            circuit.add_gate(make_gate<X>(qubit));
     circuit.reverse();
     return circuit;
 }
@@ -15,17 +15,17 @@ void add_cx(QCircuit& circuit, std::vector<std::optional<bool>>& qVal, uint32_t
     if (qVal[control].has_value() && !qVal[control].value())
         return;
     if (qVal[control].has_value() && qVal[control].value()) {
-        circuit.add_gate(std::make_shared<X>(target));
+        circuit.add_gate(make_gate<X>(target));
         if (qVal[target].has_value())
             qVal[target] = !qVal[target].value();
     } else {
-        circuit.add_gate(std::make_shared<CX>(control, true, target));
+        circuit.add_gate(make_gate<CX>(control, true, target));
         qVal[target] = std::nullopt;
     }
 }
 
 void add_ry(QCircuit& circuit, std::vector<std::optional<bool>>& qVal, uint32_t target, double theta) {
-    circuit.add_gate(std::make_shared<RY>(target, theta));
+    circuit.add_gate(make_gate<RY>(target, theta));
     qVal[target] = std::nullopt;
 }
 
@@ -36,7 +36,7 @@ void add_cry(QCircuit& circuit, std::vector<std::optional<bool>>& qVal, uint32_t
     if (qVal[control].has_value() && qVal[control].value())
         add_ry(circuit, qVal, target, theta);
     else {
-        circuit.add_gate(std::make_shared<CRY>(control, true, theta, target));
+        circuit.add_gate(make_gate<CRY>(control, true, theta, target));
         qVal[target] = std::nullopt;
     }
 }
@@ -52,7 +52,7 @@ void add_mcry(QCircuit& circuit, std::vector<std::optional<bool>>& qVal, uint32_
     if (qVal[control2].has_value() && qVal[control2].value())
         return add_cry(circuit, qVal, control1, target, theta);
     std::vector<uint32_t> controls = {control1, control2};
-    circuit.add_gate(std::make_shared<MCRY>(controls, theta, target));
+    circuit.add_gate(make_gate<MCRY>(controls, theta, target));
     qVal[target] = std::nullopt;
 }
 
@@ -85,33 +85,33 @@ void insert_scs(QCircuit& circuit, std::vector<std::optional<bool>>& qVal, uint3
 
 QCircuit prepare_ghz(uint32_t n, bool log_depth) {
     QCircuit circuit(n);
-    circuit.add_gate(std::make_shared<H>(0));
+    circuit.add_gate(make_gate<H>(0));
     if (log_depth)
         for (uint32_t i = 1u; i < n; i <<= 1)
             for (uint32_t j = 0; j < i && j + i < n; j++)
-                circuit.add_gate(std::make_shared<CX>(j, true, j + i));
+                circuit.add_gate(make_gate<CX>(j, true, j + i));
     else
         for (uint32_t i = 1; i < n; i++)
-            circuit.add_gate(std::make_shared<CX>(0, true, i));
+            circuit.add_gate(make_gate<CX>(0, true, i));
     return circuit;
 }
 
 QCircuit prepare_w(uint32_t n, bool log_depth, bool cnot_opt) {
     QCircuit circuit(n);
-    circuit.add_gate(std::make_shared<X>(0));
+    circuit.add_gate(make_gate<X>(0));
     if (!log_depth) {
         for (uint32_t i = 1; i < n; i++) {
             uint32_t j     = i - 1;
             double   p     = 1.0 / (double)(n - j);
             double   theta = 2 * std::atan2(std::sqrt(1 - p), std::sqrt(p));
             if (cnot_opt) {
-                circuit.add_gate(std::make_shared<RY>(i, -(theta - M_PI) / 2));
-                circuit.add_gate(std::make_shared<CX>(j, true, i));
-                circuit.add_gate(std::make_shared<RY>(i, (theta - M_PI) / 2));
+                circuit.add_gate(make_gate<RY>(i, -(theta - M_PI) / 2));
+                circuit.add_gate(make_gate<CX>(j, true, i));
+                circuit.add_gate(make_gate<RY>(i, (theta - M_PI) / 2));
             } else {
-                circuit.add_gate(std::make_shared<CRY>(j, true, theta, i));
+                circuit.add_gate(make_gate<CRY>(j, true, theta, i));
             }
-            circuit.add_gate(std::make_shared<CX>(i, true, j));
+            circuit.add_gate(make_gate<CX>(i, true, j));
         }
         return circuit;
     }
@@ -137,13 +137,13 @@ QCircuit prepare_w(uint32_t n, bool log_depth, bool cnot_opt) {
         double p     = (double)curr / (double)total;
         double theta = 2 * std::atan2(std::sqrt(1 - p), std::sqrt(p));
         if (cnot_opt) {
-            circuit.add_gate(std::make_shared<RY>(q_next, -(theta - M_PI) / 2));
-            circuit.add_gate(std::make_shared<CX>(q, true, q_next));
-            circuit.add_gate(std::make_shared<RY>(q_next, (theta - M_PI) / 2));
+            circuit.add_gate(make_gate<RY>(q_next, -(theta - M_PI) / 2));
+            circuit.add_gate(make_gate<CX>(q, true, q_next));
+            circuit.add_gate(make_gate<RY>(q_next, (theta - M_PI) / 2));
         } else {
-            circuit.add_gate(std::make_shared<CRY>(q, true, theta, q_next));
+            circuit.add_gate(make_gate<CRY>(q, true, theta, q_next));
         }
-        circuit.add_gate(std::make_shared<CX>(q_next, true, q));
+        circuit.add_gate(make_gate<CX>(q_next, true, q));
         q_next++;
     }
     return circuit;
@@ -153,7 +153,7 @@ QCircuit prepare_dicke_state(int n, int k) {
     QCircuit                         circuit(n);
     std::vector<std::optional<bool>> qVal(n, false);
     for (int i = 0; i < k; ++i) {
-        circuit.add_gate(std::make_shared<X>(i));
+        circuit.add_gate(make_gate<X>(i));
         qVal[i] = true;
     }
     for (int i = 0; i < n - 1; ++i)
@@ -0,0 +1,230 @@
+#include "prepare-state.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace xyz {
+namespace {
+
+/* tied qubit orderings tried before settling for the best one seen so far */
+constexpr std::size_t max_candidates = 720;
+
+using entry = std::pair<index_t, double>;
+
+int64_t quantize(double x) {
+    return (int64_t)std::llround(x / QRState::eps);
+}
+
+uint64_t mix(uint64_t a, uint64_t b) {
+    return splitmix64(a ^ splitmix64(b));
+}
+
+uint32_t count_ones(const Signature& s) {
+    uint32_t count = 0;
+    for (uint64_t word : s.words)
+        count += (uint32_t)__builtin_popcountll(word);
+    return count;
+}
+
+uint32_t position(const state_symmetry& symmetry, uint32_t qubit) {
+    return symmetry.qubits.empty() ? qubit : symmetry.qubits[qubit];
+}
+
+/* the relabeled entries in index order, negated when needed so the first weight is positive */
+std::vector<entry> relabel_entries(const QRState& state, state_symmetry& symmetry) {
+    std::vector<entry> entries;
+    entries.reserve(state.cardinality());
+    state.index_to_weight.for_each([&](index_t index, double weight) {
+        index_t x = index ^ symmetry.flips, y = 0;
+        for (uint32_t q = 0; x != 0; q++, x >>= 1)
+            if (x & 1)
+                y |= index_t(1) << position(symmetry, q);
+        entries.emplace_back(y, weight);
+    });
+    std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) { return a.first < b.first; });
+    symmetry.negate = !entries.empty() && entries.front().second < 0;
+    if (symmetry.negate)
+        for (auto& e : entries)
+            e.second = -e.second;
+    return entries;
+}
+
+bool less_entries(const std::vector<entry>& a, const std::vector<entry>& b) {
+    for (std::size_t i = 0; i < a.size(); i++) {
+        if (a[i].first != b[i].first)
+            return a[i].first < b[i].first;
+        if (quantize(a[i].second) != quantize(b[i].second))
+            return quantize(a[i].second) < quantize(b[i].second);
+    }
+    return false;
+}
+
+QRState make_rstate(const std::vector<entry>& entries, uint32_t n_bits) {
+    WeightMap<double> weights;
+    weights.reserve(entries.size());
+    for (const auto& [index, weight] : entries)
+        weights.push_back(index, weight);
+    return QRState(std::move(weights), n_bits);
+}
+
+} // namespace
+
+QRState state_symmetry::operator()(const QRState& state) const {
+    state_symmetry applied = *this;
+    auto           entries = relabel_entries(state, applied);
+    if (applied.negate != negate)
+        for (auto& e : entries)
+            e.second = -e.second;
+    return make_rstate(entries, state.n_bits);
+}
+
+state_symmetry state_symmetry::then(const state_symmetry& next, uint32_t n_bits) const {
+    state_symmetry composed;
+    if (!qubits.empty() || !next.qubits.empty())
+        for (uint32_t q = 0; q < n_bits; q++)
+            composed.qubits.push_back(position(next, position(*this, q)));
+    composed.flips = flips;
+    for (uint32_t q = 0; q < n_bits; q++)
+        if ((next.flips >> position(*this, q)) & 1)
+            composed.flips ^= index_t(1) << q;
+    composed.negate = negate != next.negate;
+    return composed;
+}
+
+QRState canonical_state(const QRState& state, state_symmetry* symmetry) {
+    const uint32_t n = state.n_bits, m = state.cardinality();
+    if (m == 0) {
+        if (symmetry)
+            *symmetry = state_symmetry();
+        return state;
+    }
+
+    /* orient each qubit so its |1> side holds fewer entries, then less weight; qubits where both sides
+     * agree are ambiguous and tried both ways */
+    std::vector<Signature> columns = state.get_qubit_signatures();
+    const Signature        all     = state.get_const1_signature();
+    std::vector<double>    mass(n, 0.0);
+    double                 total = 0.0;
+    state.index_to_weight.for_each([&](index_t index, double weight) {
+        total += weight * weight;
+        for (uint32_t q = 0; q < n; q++)
+            if ((index >> q) & 1)
+                mass[q] += weight * weight;
+    });
+    index_t               flips = 0;
+    std::vector<bool>     ambiguous(n, false);
+    std::vector<uint64_t> color(n);
+    for (uint32_t q = 0; q < n; q++) {
+        const uint32_t ones    = count_ones(columns[q]);
+        const auto     plain   = std::pair(ones, quantize(mass[q]));
+        const auto     flipped = std::pair(m - ones, quantize(total - mass[q]));
+        if (flipped < plain) {
+            flips ^= index_t(1) << q;
+            columns[q] = columns[q] ^ all;
+        }
+        ambiguous[q] = flipped == plain;
+        const auto key = std::min(plain, flipped);
+        color[q]       = mix(mix(key.first, (uint64_t)key.second), ambiguous[q]);
+    }
+
+    /* refine colors by the colors of the other qubits and how often each one disagrees with the qubit,
+     * counted up to complement when a flip is still open, until the partition stops splitting */
+    std::vector<std::vector<uint32_t>> disagree(n, std::vector<uint32_t>(n, 0));
+    for (uint32_t q = 0; q < n; q++)
+        for (uint32_t r = 0; r < q; r++) {
+            uint32_t d = count_ones(columns[q] ^ columns[r]);
+            if (ambiguous[q] || ambiguous[r])
+                d = std::min(d, m - d);
+            disagree[q][r] = disagree[r][q] = d;
+        }
+    auto n_colors = [&] {
+        std::vector<uint64_t> sorted = color;
+        std::sort(sorted.begin(), sorted.end());
+        return std::unique(sorted.begin(), sorted.end()) - sorted.begin();
+    };
+    for (auto before = n_colors();;) {
+        std::vector<uint64_t> next(n);
+        for (uint32_t q = 0; q < n; q++) {
+            std::vector<uint64_t> around;
+            for (uint32_t r = 0; r < n; r++)
+                if (r != q)
+                    around.push_back(mix(color[r], disagree[q][r]));
+            std::sort(around.begin(), around.end());
+            next[q] = color[q];
+            for (uint64_t a : around)
+                next[q] = mix(next[q], a);
+        }
+        color      = std::move(next);
+        auto after = n_colors();
+        if (after == before)
+            break;
+        before = after;
+    }
+
+    /* cells of equal color are ordered by trying their arrangements; qubits with the same settled column
+     * are interchangeable, so only distinct arrangements of those classes are tried */
+    std::vector<uint32_t> order(n);
+    for (uint32_t q = 0; q < n; q++)
+        order[q] = q;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return color[a] < color[b]; });
+    std::vector<uint32_t>              cell_of(n), class_of(n);
+    std::vector<std::vector<uint32_t>> cells, classes;
+    for (uint32_t i = 0; i < n; i++) {
+        const uint32_t q = order[i];
+        if (i == 0 || color[q] != color[order[i - 1]])
+            cells.emplace_back();
+        uint32_t c = (uint32_t)classes.size();
+        if (!ambiguous[q])
+            for (uint32_t r : cells.back())
+                if (!ambiguous[r] && columns[r] == columns[q]) {
+                    c = class_of[r];
+                    break;
+                }
+        if (c == classes.size())
+            classes.emplace_back();
+        classes[c].push_back(q);
+        class_of[q] = c;
+        cells.back().push_back(c);
+    }
+    std::vector<uint32_t> open;
+    for (uint32_t q = 0; q < n; q++)
+        if (ambiguous[q])
+            open.push_back(q);
+
+    state_symmetry     best, candidate;
+    std::vector<entry> best_entries;
+    std::size_t        n_candidates = 0;
+    candidate.qubits.resize(n);
+    for (uint64_t pattern = 0; pattern < (uint64_t(1) << std::min<std::size_t>(open.size(), 63)); pattern++) {
+        candidate.flips = flips;
+        for (std::size_t k = 0; k < open.size(); k++)
+            if ((pattern >> k) & 1)
+                candidate.flips ^= index_t(1) << open[k];
+        for (auto& cell : cells)
+            std::sort(cell.begin(), cell.end());
+        for (bool more = true; more && n_candidates < max_candidates; n_candidates++) {
+            std::vector<std::size_t> used(classes.size(), 0);
+            uint32_t                 p = 0;
+            for (const auto& cell : cells)
+                for (uint32_t c : cell)
+                    candidate.qubits[classes[c][used[c]++]] = p++;
+            auto entries = relabel_entries(state, candidate);
+            if (best_entries.empty() || less_entries(entries, best_entries)) {
+                best         = candidate;
+                best_entries = std::move(entries);
+            }
+            more = false;
+            for (auto cell = cells.rbegin(); cell != cells.rend() && !more; ++cell)
+                more = std::next_permutation(cell->begin(), cell->end());
+        }
+        if (n_candidates >= max_candidates)
+            break;
+    }
+    if (symmetry)
+        *symmetry = best;
+    return make_rstate(best_entries, n);
+}
+
+} // namespace xyz
@@ -1,5 +1,7 @@
 #include "qcircuit.hpp"
 
+#include "state-vector.hpp"
+
 #include <algorithm>
 #include <fstream>
 #include <memory>
@@ -10,48 +12,23 @@ namespace xyz {
 void QCircuit::add_gate(std::shared_ptr<QGate> gate) {
     pGates.push_back(gate);
 }
+QCircuit::QCircuit(const GateList& list) : num_qbits(list.num_qbits) {
+    pGates.reserve(list.size());
+    for (const auto& op : list.ops)
+        pGates.push_back(list.to_gate(op));
+}
+GateList QCircuit::to_gate_list() const {
+    GateList list(num_qbits);
+    list.ops.reserve(pGates.size());
+    for (const auto& pGate : pGates)
+        pGate->lower(list);
+    return list;
+}
 std::string QCircuit::to_qasm2() const {
-    std::string qasm = "";
-    qasm += "OPENQASM 2.0;\n";
-    qasm += "include \"qelib1.inc\";\n";
-    qasm += "qreg q[" + std::to_string(num_qbits) + "];\n";
-    for (const auto& pGate : pGates) {
-        qasm += pGate->to_string() + ";\n";
-    }
-    return qasm;
+    return to_gate_list().to_qasm2();
 }
 QCircuit decompose_circuit(const QCircuit& circuit) {
-    QCircuit new_circuit(circuit.num_qbits);
-    for (const auto& pGate : circuit.pGates) {
-        // if the class is a cry
-        std::shared_ptr<CRY> cry_gate = std::dynamic_pointer_cast<CRY>(pGate);
-        if (cry_gate) {
-            new_circuit.add_gate(std::make_shared<RY>(cry_gate->target, cry_gate->theta / 2));
-            new_circuit.add_gate(std::make_shared<CX>(cry_gate->ctrl, true, cry_gate->target));
-            if (cry_gate->phase == false)
-                new_circuit.add_gate(std::make_shared<RY>(cry_gate->target, cry_gate->theta / 2));
-            else
-                new_circuit.add_gate(std::make_shared<RY>(cry_gate->target, -cry_gate->theta / 2));
-            new_circuit.add_gate(std::make_shared<CX>(cry_gate->ctrl, true, cry_gate->target));
-            continue;
-        }
-        // if the class is a cx
-        std::shared_ptr<CX> cx_gate = std::dynamic_pointer_cast<CX>(pGate);
-        if (cx_gate) {
-            if (cx_gate->phase == false) {
-                new_circuit.add_gate(std::make_shared<X>(cx_gate->ctrl));
-                new_circuit.add_gate(std::make_shared<CX>(cx_gate->ctrl, true, cx_gate->target));
-                new_circuit.add_gate(std::make_shared<X>(cx_gate->ctrl));
-                continue;
-            } else {
-                new_circuit.add_gate(pGate);
-                continue;
-            }
-        }
-
-        new_circuit.add_gate(pGate);
-    }
-    return new_circuit;
+    return QCircuit(decompose(circuit.to_gate_list()));
 }
 void QCircuit::reverse() {
     std::reverse(pGates.begin(), pGates.end());
@@ -82,13 +59,15 @@ void write_qasm2(const QCircuit& circuit, const std::string& filename) {
 }
 QCircuit read_qasm2(const std::string& filename, bool verbose) {
     std::ifstream file(filename);
-    std::string   line;
-    QCircuit      circuit;
-
     if (verbose)
         std::cout << "Reading file: " << filename << std::endl;
+    return read_qasm2(file, verbose);
+}
+QCircuit read_qasm2(std::istream& in, bool verbose) {
+    std::string line;
+    QCircuit    circuit;
 
-    while (std::getline(file, line)) {
+    while (std::getline(in, line)) {
         if (verbose) {
             std::cout << "----------------------------------------" << std::endl;
             std::cout << line << std::endl;
@@ -105,7 +84,7 @@ QCircuit read_qasm2(const std::string& filename, bool verbose) {
             auto pos1   = line.find("[");
             auto pos2   = line.find("]", pos1);
             auto target = std::stoi(line.substr(pos1 + 1, pos2 - pos1 - 1));
-            circuit.add_gate(std::make_shared<X>(target));
+            circuit.add_gate(make_gate<X>(target));
             continue;
         } else if (line.find("cx ") == 0) {
             auto pos1   = line.find("[");
@@ -114,7 +93,7 @@ QCircuit read_qasm2(const std::string& filename, bool verbose) {
             auto pos4   = line.find("]", pos3);
             auto ctrl   = std::stoi(line.substr(pos1 + 1, pos2 - pos1 - 1));
             auto target = std::stoi(line.substr(pos3 + 1, pos4 - pos3 - 1));
-            circuit.add_gate(std::make_shared<CX>(ctrl, true, target));
+            circuit.add_gate(make_gate<CX>(ctrl, true, target));
             continue;
         } else if (line.find("ry") == 0) // ry
         {
@@ -124,7 +103,7 @@ QCircuit read_qasm2(const std::string& filename, bool verbose) {
             auto pos4   = line.find(")", pos3);
             auto target = std::stoi(line.substr(pos1 + 1, pos2 - pos1 - 1));
             auto theta  = std::stod(line.substr(pos3 + 1, pos4 - pos3 - 1));
-            circuit.add_gate(std::make_shared<RY>(target, theta));
+            circuit.add_gate(make_gate<RY>(target, theta));
             continue;
         } else if (line.find("cry") == 0) {
             auto pos1   = line.find("[");
@@ -136,43 +115,43 @@ QCircuit read_qasm2(const std::string& filename, bool verbose) {
             auto ctrl   = std::stoi(line.substr(pos1 + 1, pos2 - pos1 - 1));
             auto target = std::stoi(line.substr(pos3 + 1, pos4 - pos3 - 1));
             auto theta  = std::stod(line.substr(pos5 + 1, pos6 - pos5 - 1));
-            circuit.add_gate(std::make_shared<CRY>(ctrl, true, theta, target));
+            circuit.add_gate(make_gate<CRY>(ctrl, true, theta, target));
             continue;
         } else if (line.find("h ") == 0) {
             auto pos1   = line.find("[");
             auto pos2   = line.find("]", pos1);
             auto target = std::stoi(line.substr(pos1 + 1, pos2 - pos1 - 1));
-            circuit.add_gate(std::make_shared<H>(target));
+            circuit.add_gate(make_gate<H>(target));
             continue;
         } else if (line.find("tdg ") == 0) {
             auto pos1   = line.find("[");
             auto pos2   = line.find("]", pos1);
             auto target = std::stoi(line.substr(pos1 + 1, pos2 - pos1 - 1));
-            circuit.add_gate(std::make_shared<Tdg>(target));
+            circuit.add_gate(make_gate<Tdg>(target));
             continue;
         } else if (line.find("t ") == 0) {
             auto pos1   = line.find("[");
             auto pos2   = line.find("]", pos1);
             auto target = std::stoi(line.substr(pos1 + 1, pos2 - pos1 - 1));
-            circuit.add_gate(std::make_shared<T>(target));
+            circuit.add_gate(make_gate<T>(target));
             continue;
         } else if (line.find("sdg ") == 0) {
             auto pos1   = line.find("[");
             auto pos2   = line.find("]", pos1);
             auto target = std::stoi(line.substr(pos1 + 1, pos2 - pos1 - 1));
-            circuit.add_gate(std::make_shared<Sdg>(target));
+            circuit.add_gate(make_gate<Sdg>(target));
             continue;
         } else if (line.find("s ") == 0) {
             auto pos1   = line.find("[");
             auto pos2   = line.find("]", pos1);
             auto target = std::stoi(line.substr(pos1 + 1, pos2 - pos1 - 1));
-            circuit.add_gate(std::make_shared<S>(target));
+            circuit.add_gate(make_gate<S>(target));
             continue;
         } else if (line.find("z ") == 0) {
             auto pos1   = line.find("[");
             auto pos2   = line.find("]", pos1);
             auto target = std::stoi(line.substr(pos1 + 1, pos2 - pos1 - 1));
-            circuit.add_gate(std::make_shared<Z>(target));
+            circuit.add_gate(make_gate<Z>(target));
             continue;
         } else if (line.find("cx_false") == 0) {
             auto pos1   = line.find("[");
@@ -181,7 +160,7 @@ QCircuit read_qasm2(const std::string& filename, bool verbose) {
             auto pos4   = line.find("]", pos3);
             auto ctrl   = std::stoi(line.substr(pos1 + 1, pos2 - pos1 - 1));
             auto target = std::stoi(line.substr(pos3 + 1, pos4 - pos3 - 1));
-            circuit.add_gate(std::make_shared<CX>(ctrl, false, target));
+            circuit.add_gate(make_gate<CX>(ctrl, false, target));
             continue;
         } else if (line.find("cry_false") == 0) {
             auto pos1   = line.find("[");
@@ -193,7 +172,7 @@ QCircuit read_qasm2(const std::string& filename, bool verbose) {
             auto ctrl   = std::stoi(line.substr(pos1 + 1, pos2 - pos1 - 1));
             auto target = std::stoi(line.substr(pos3 + 1, pos4 - pos3 - 1));
             auto theta  = std::stod(line.substr(pos5 + 1, pos6 - pos5 - 1));
-            circuit.add_gate(std::make_shared<CRY>(ctrl, false, theta, target));
+            circuit.add_gate(make_gate<CRY>(ctrl, false, theta, target));
             continue;
         } else if (line.find("ccx ") == 0) {
             auto pos1   = line.find("[");
@@ -205,7 +184,7 @@ QCircuit read_qasm2(const std::string& filename, bool verbose) {
             auto ctrl1  = std::stoi(line.substr(pos1 + 1, pos2 - pos1 - 1));
             auto ctrl2  = std::stoi(line.substr(pos3 + 1, pos4 - pos3 - 1));
             auto target = std::stoi(line.substr(pos5 + 1, pos6 - pos5 - 1));
-            circuit.add_gate(std::make_shared<CCX>(ctrl1, ctrl2, target));
+            circuit.add_gate(make_gate<CCX>(ctrl1, ctrl2, target));
             continue;
         } else {
             std::cerr << "Unknown gate: " << line << std::endl;
@@ -214,18 +193,15 @@ QCircuit read_qasm2(const std::string& filename, bool verbose) {
     return circuit;
 }
 QRState simulate_circuit(const QCircuit& circuit, const QRState& state, bool verbose) {
-    QRState new_state = state;
-    for (const auto& pGate : circuit.pGates) {
-        if (verbose) {
-            std::cout << "Applying gate: " << pGate->to_string() << std::endl;
-            std::cout << "State before: " << new_state << std::endl;
-        }
-        new_state = (*pGate)(new_state);
-        if (verbose) {
-            std::cout << "State after: " << new_state << std::endl;
-            std::cout << "----------------------------------------" << std::endl;
-        }
-    }
-    return new_state;
+    return simulate(circuit.to_gate_list(), state, verbose);
+}
+QRState simulate_circuit(const QCircuit& circuit, const QRState& state, const sim_params& params, sim_stats* stats) {
+    return simulate(circuit.to_gate_list(), state, params, stats);
+}
+QState simulate_circuit(const QCircuit& circuit, const QState& state, const sim_params& params, sim_stats* stats) {
+    return simulate(circuit.to_gate_list(), state, params, stats);
+}
+std::vector<QRState> simulate_circuit(const QCircuit& circuit, const std::vector<QRState>& states, uint32_t n_threads) {
+    return simulate_batch(circuit.to_gate_list(), states, n_threads);
 }
 } // namespace xyz
@@ -1,11 +1,17 @@
 #include "qgate.hpp"
 
+#include "kernels.hpp"
 #include "qstate.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <optional>
 #include <stdexcept>
+#include <type_traits>
 
 namespace xyz {
+using namespace kernels;
+
 bool Rotation::is_trivial(double theta, bool use_x) {
     bool is_zero = std::abs(theta) < eps || std::abs(theta - 2 * M_PI) < eps;
     bool is_pi   = std::abs(theta - M_PI) < eps || std::abs(theta + M_PI) < eps;
@@ -14,213 +20,69 @@ bool Rotation::is_trivial(double theta, bool use_x) {
     return is_zero;
 }
 
-QRState X::operator()(const QRState& state, const bool reverse) const {
+QState QGate::operator()(const QState& state, const bool reverse) const {
+    GateList list;
+    lower(list);
+    QState result = state;
+    list.apply(list.ops.front(), result, reverse);
+    return result;
+}
+
+void X::apply(QRState& state, const bool reverse) const {
     (void)reverse;
-    QRState new_state;
-    for (const auto& [index, weight] : state.index_to_weight) {
-        uint32_t new_index                   = index ^ (1 << target);
-        new_state.index_to_weight[new_index] = weight;
-    }
-    new_state.n_bits = state.n_bits;
-    return new_state;
+    apply_kernel(state, [&](WeightMap<double>& map, uint64_t* hash) { flip_pairs(map, target, always, hash); });
 }
 
-QRState RU2::operator()(const QRState& state, uint32_t target, const bool reverse) const {
-    QRState new_state;
-    for (const auto& [index, weight] : state.index_to_weight) {
-        if (new_state.index_to_weight.find(index) == new_state.index_to_weight.end())
-            new_state.index_to_weight[index] = 0;
-        uint32_t new_index = index ^ (1 << target);
-        if (index & (1 << target)) {
-            new_state.index_to_weight[new_index] += c10[reverse] * weight;
-            new_state.index_to_weight[index] += c11[reverse] * weight;
-        } else {
-            new_state.index_to_weight[index] += c00[reverse] * weight;
-            new_state.index_to_weight[new_index] += c01[reverse] * weight;
-        }
-    }
-    for (auto it = new_state.index_to_weight.begin(); it != new_state.index_to_weight.end();) {
-        if (std::abs(it->second) < QRState::eps)
-            it = new_state.index_to_weight.erase(it);
-        else
-            ++it;
-    }
-    new_state.n_bits = state.n_bits;
-    return new_state;
+void RU2::rotate(QRState& state, uint32_t target, const bool reverse) const {
+    apply_kernel(state, [&](WeightMap<double>& map, uint64_t* hash) {
+        rotate_pairs(map, target, c00[reverse], c01[reverse], c10[reverse], c11[reverse], always, hash);
+    });
 }
 
 QState U2::operator()(const QState& state, uint32_t target, const bool reverse) const {
-    QState new_state;
-    for (const auto& [index, weight] : state.index_to_weight) {
-        if (new_state.index_to_weight.find(index) == new_state.index_to_weight.end())
-            new_state.index_to_weight[index] = 0;
-        uint32_t new_index = index ^ (1 << target);
-        if (index & (1 << target)) {
-            new_state.index_to_weight[new_index] += c10[reverse] * weight;
-            new_state.index_to_weight[index] += c11[reverse] * weight;
-        } else {
-            new_state.index_to_weight[index] += c00[reverse] * weight;
-            new_state.index_to_weight[new_index] += c01[reverse] * weight;
-        }
-    }
-    for (auto it = new_state.index_to_weight.begin(); it != new_state.index_to_weight.end();) {
-        if (std::abs(it->second) < QState::eps)
-            it = new_state.index_to_weight.erase(it);
-        else
-            ++it;
-    }
-    new_state.n_bits = state.n_bits;
-    return new_state;
+    QState result = state;
+    rotate_pairs(result.index_to_weight, target, c00[reverse], c01[reverse], c10[reverse], c11[reverse], always);
+    return result;
 }
 
-QRState U2::operator()(const QRState& state, uint32_t target, const bool reverse) const {
-    QRState new_state;
-    for (const auto& [index, weight] : state.index_to_weight) {
-        if (new_state.index_to_weight.find(index) == new_state.index_to_weight.end())
-            new_state.index_to_weight[index] = 0;
-        uint32_t new_index = index ^ (1 << target);
-        if (index & (1 << target)) {
-            new_state.index_to_weight[new_index] += c10[reverse].real() * weight;
-            new_state.index_to_weight[index] += c11[reverse].real() * weight;
-        } else {
-            new_state.index_to_weight[index] += c00[reverse].real() * weight;
-            new_state.index_to_weight[new_index] += c01[reverse].real() * weight;
-        }
-    }
-    for (auto it = new_state.index_to_weight.begin(); it != new_state.index_to_weight.end();) {
-        if (std::abs(it->second) < QRState::eps)
-            it = new_state.index_to_weight.erase(it);
-        else
-            ++it;
-    }
-    new_state.n_bits = state.n_bits;
-    return new_state;
+void U2::rotate(QRState& state, uint32_t target, const bool reverse) const {
+    apply_kernel(state, [&](WeightMap<double>& map, uint64_t* hash) {
+        rotate_pairs(map, target, c00[reverse].real(), c01[reverse].real(), c10[reverse].real(), c11[reverse].real(),
+                     always, hash);
+    });
 }
 
-QRState CX::operator()(const QRState& state, const bool reverse) const {
+void CX::apply(QRState& state, const bool reverse) const {
     (void)reverse; // the conjugate of CX is CX
-    QRState new_state;
-    for (const auto& [index, weight] : state.index_to_weight) {
-        uint32_t new_index = index;
-        if ((bool)((index >> ctrl) & (uint32_t)1u) == phase)
-            new_index ^= (1 << target);
-        new_state.index_to_weight[new_index] = weight;
-    }
-    new_state.n_bits = state.n_bits;
-    return new_state;
+    auto active = [&](index_t index) { return is_active(index); };
+    apply_kernel(state, [&](WeightMap<double>& map, uint64_t* hash) { flip_pairs(map, target, active, hash); });
 }
 
-QRState CCX::operator()(const QRState& state, const bool reverse) const {
+void CCX::apply(QRState& state, const bool reverse) const {
     (void)reverse; // the conjugate of CCX is CCX
-    QRState new_state;
-    for (const auto& [index, weight] : state.index_to_weight) {
-        uint32_t new_index = index;
-        if ((bool)((index >> ctrls[0]) & (uint32_t)1u) == phases[0] &&
-            (bool)((index >> ctrls[1]) & (uint32_t)1u) == phases[1])
-            new_index ^= (1 << target);
-        new_state.index_to_weight[new_index] = weight;
-    }
-    new_state.n_bits = state.n_bits;
-    return new_state;
+    auto active = [&](index_t index) { return is_active(index); };
+    apply_kernel(state, [&](WeightMap<double>& map, uint64_t* hash) { flip_pairs(map, target, active, hash); });
 }
 
-QRState CRY::operator()(const QRState& state, const bool reverse) const {
-    auto    _theta = reverse ? -theta : theta;
-    QRState new_state;
-    for (const auto& [index, weight] : state.index_to_weight) {
-        if ((bool)((index >> ctrl) & (uint32_t)1u) != phase) {
-            new_state.index_to_weight[index] = weight;
-            continue;
-        }
-        if (new_state.index_to_weight.find(index) == new_state.index_to_weight.end())
-            new_state.index_to_weight[index] = 0;
-        uint32_t new_index = index ^ (1 << target);
-        if (index & (1 << target)) {
-            new_state.index_to_weight[new_index] += c10[reverse] * weight;
-            new_state.index_to_weight[index] += c11[reverse] * weight;
-        } else {
-            new_state.index_to_weight[index] += c00[reverse] * weight;
-            new_state.index_to_weight[new_index] += c01[reverse] * weight;
-        }
-    }
-    for (auto it = new_state.index_to_weight.begin(); it != new_state.index_to_weight.end();) {
-        if (std::abs(it->second) < QRState::eps)
-            it = new_state.index_to_weight.erase(it);
-        else
-            ++it;
-    }
-    new_state.n_bits = state.n_bits;
-    return new_state;
+void CRY::apply(QRState& state, const bool reverse) const {
+    rotate_masked(state, target, std::array<double, 4>{c00[0], c01[0], c10[0], c11[0]}, ctrl_mask, ctrl_value, reverse);
 }
 
-QRState MCRY::operator()(const QRState& state, const bool reverse) const {
-    QRState new_state;
-    for (const auto& [index, weight] : state.index_to_weight) {
-        bool valid = true;
-        for (uint32_t i = 0; i < ctrls.size(); i++) {
-            if ((bool)((index >> ctrls[i]) & (uint32_t)1) != phases[i]) {
-                valid = false;
-                break;
-            }
-        }
-        if (!valid) {
-            new_state.index_to_weight[index] = weight;
-            continue;
-        }
-        if (new_state.index_to_weight.find(index) == new_state.index_to_weight.end())
-            new_state.index_to_weight[index] = 0;
-        uint32_t new_index = index ^ (1 << target);
-        if (index & (1 << target)) {
-            new_state.index_to_weight[new_index] += c10[reverse] * weight;
-            new_state.index_to_weight[index] += c11[reverse] * weight;
-        } else {
-            new_state.index_to_weight[index] += c00[reverse] * weight;
-            new_state.index_to_weight[new_index] += c01[reverse] * weight;
-        }
-    }
-    for (auto it = new_state.index_to_weight.begin(); it != new_state.index_to_weight.end();) {
-        if (std::abs(it->second) < QRState::eps)
-            it = new_state.index_to_weight.erase(it);
-        else
-            ++it;
-    }
-    new_state.n_bits = state.n_bits;
-    return new_state;
+void MCRY::apply(QRState& state, const bool reverse) const {
+    rotate_masked(state, target, std::array<double, 4>{c00[0], c01[0], c10[0], c11[0]}, ctrl_mask, ctrl_value, reverse);
 }
 
-QRState S::operator()(const QRState& state, const bool reverse) const {
+void S::apply(QRState& state, const bool reverse) const {
     (void)reverse;
     throw std::runtime_error("S gate not supported in real-amplitude QRState simulation");
 }
 
-QRState MCMY::operator()(const QRState& state, const bool reverse) const {
-    QRState result = state.clone();
-    for (uint32_t i = 0; i < rotation_angles.size(); i++) {
-        std::vector<uint32_t> active_ctrls;
-        std::vector<bool>     active_phases;
-        for (uint32_t j = 0; j < ctrls.size(); j++) {
-            active_ctrls.push_back(ctrls[j]);
-            active_phases.push_back((i >> j) & 1);
-        }
-        MCRY mcry(active_ctrls, active_phases, rotation_angles[i], target);
-        result = mcry(result, reverse);
-    }
-    return result;
+void MCMY::apply(QRState& state, const bool reverse) const {
+    rotate_multiplexed(state, ctrls, target, rotation_angles, reverse);
 }
 
-QRState QROM_MCRY::operator()(const QRState& state, const bool reverse) const {
-    QRState result = state.clone();
-    for (uint32_t i = 0; i < rotation_table.size(); i++) {
-        std::vector<uint32_t> active_ctrls;
-        std::vector<bool>     active_phases;
-        for (uint32_t j = 0; j < ctrls.size(); j++) {
-            active_ctrls.push_back(ctrls[j]);
-            active_phases.push_back((i >> j) & 1);
-        }
-        MCRY mcry(active_ctrls, active_phases, rotation_table[i], target);
-        result = mcry(result, reverse);
-    }
-    return result;
+void QROM_MCRY::apply(QRState& state, const bool reverse) const {
+    rotate_multiplexed(state, ctrls, target, rotation_table, reverse);
 }
 
-} // namespace xyz
\ No newline at end of file
+} // namespace xyz
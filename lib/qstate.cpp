@@ -1,5 +1,6 @@
 #include "qstate.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <optional>
@@ -10,145 +11,204 @@
 
 namespace xyz {
 bool QRState::is_ground() const {
-    return index_to_weight.size() == 1 && index_to_weight.find(0) != index_to_weight.end();
+    if (index_to_weight.size() != 1)
+        return false;
+    return is_dense() ? index_to_weight.dense()[0] != 0 : index_to_weight.entries()[0].first == 0;
+}
+void QRState::update_storage() {
+    if (n_bits < dense_min_bits || n_bits > dense_max_bits)
+        return;
+    double fill = (double)cardinality() / (double)(1ull << n_bits);
+    if (!is_dense() && fill >= dense_fill)
+        index_to_weight.make_dense(n_bits);
+    else if (is_dense() && fill < sparse_fill)
+        index_to_weight.make_sparse();
 }
 std::string QRState::to_string() const {
     std::string str;
-    for (auto it = index_to_weight.begin(); it != index_to_weight.end(); it++) {
-        auto index  = it->first;
-        auto weight = it->second;
+    index_to_weight.for_each([&](index_t index, double weight) {
+        if (!str.empty())
+            str += " + ";
         str += std::to_string(weight) + "*|";
         for (uint32_t i = 0; i < n_bits; i++)
             str += ((index >> i) & 1) ? "1" : "0";
         str += ">";
-        if (std::next(it) != index_to_weight.end())
-            str += " + ";
-    }
+    });
     return str;
 }
 std::ostream& operator<<(std::ostream& os, const QRState& obj) {
     os << obj.to_string();
     return os;
 }
-std::unordered_map<uint32_t, double> QRState::to_ry_table(uint32_t target) const {
-    std::unordered_map<uint32_t, double> ry_table;
-    for (const auto& [index, weight] : index_to_weight) {
-        auto index_0 = index & (~(1 << target));
-        auto index_1 = index | (1 << target);
-
-        if (ry_table.find(index_0) != ry_table.end())
-            continue;
-        if (index_to_weight.find(index_0) == index_to_weight.end())
+std::unordered_map<index_t, double, IndexHash> QRState::to_ry_table(uint32_t target) const {
+    std::unordered_map<index_t, double, IndexHash> ry_table;
+    for_each_pair(index_to_weight, target, [&](index_t index_0, const double* weight_0, const double* weight_1) {
+        if (!weight_0)
             ry_table[index_0] = M_PI;
-        else if (index_to_weight.find(index_1) == index_to_weight.end())
+        else if (!weight_1)
             ry_table[index_0] = 0;
         else
-            ry_table[index_0] = 2 * atan2(index_to_weight.at(index_1), index_to_weight.at(index_0));
-    }
+            ry_table[index_0] = 2 * atan2(*weight_1, *weight_0);
+    });
     return ry_table;
 }
+uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+namespace {
+void transpose64(uint64_t rows[64]) {
+    uint64_t mask = 0x00000000ffffffffull;
+    for (uint32_t j = 32; j != 0; j >>= 1, mask ^= mask << j)
+        for (uint32_t k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            uint64_t t = ((rows[k] >> j) ^ rows[k | j]) & mask;
+            rows[k] ^= t << j;
+            rows[k | j] ^= t;
+        }
+}
+} // namespace
+bool Signature::none() const {
+    return std::all_of(words.begin(), words.end(), [](uint64_t w) { return w == 0; });
+}
+Signature Signature::operator^(const Signature& other) const {
+    Signature result = *this;
+    for (std::size_t i = 0; i < words.size(); i++)
+        result.words[i] ^= other.words[i];
+    return result;
+}
+std::size_t SignatureHash::operator()(const Signature& signature) const {
+    uint64_t h = splitmix64(signature.words.size());
+    for (uint64_t w : signature.words)
+        h = splitmix64(h ^ w);
+    return h;
+}
+uint64_t QRState::repr_seed(uint32_t n_bits) {
+    return splitmix64(0x5851f42d4c957f2dull ^ n_bits);
+}
+uint64_t QRState::repr_term(index_t index, double weight) {
+    int64_t q = (int64_t)std::llround(weight / QRState::eps);
+    if (q == 0)
+        return 0;
+    uint64_t key = (uint64_t)index;
+    if constexpr (sizeof(index_t) > 8)
+        key = splitmix64(key) ^ (uint64_t)(index >> 32 >> 32);
+    return splitmix64(splitmix64(key) ^ (uint64_t)q);
+}
 uint64_t QRState::repr() const {
     if (hash_value.has_value())
         return hash_value.value();
-    uint64_t h   = 1469598103934665603ull;
-    auto     mix = [&](uint64_t x) {
-        h ^= x;
-        h *= 1099511628211ull;
-    };
-    mix(n_bits);
-    for (const auto& [index, weight] : index_to_weight) {
-        mix(index);
-        int64_t q = (int64_t)std::llround(weight / QRState::eps);
-        mix((uint64_t)q);
-    }
+    uint64_t h = repr_seed(n_bits);
+    index_to_weight.for_each([&](index_t index, double weight) { h ^= repr_term(index, weight); });
     hash_value = h;
     return h;
 }
 QRState QRState::clone() const {
-    std::map<uint32_t, double> index_to_weight_copy;
-    for (const auto& [index, weight] : index_to_weight)
-        index_to_weight_copy[index] = weight;
-    return QRState(index_to_weight_copy, n_bits);
+    return QRState(index_to_weight, n_bits);
 }
 bool QRState::operator==(const QRState& other) const {
     if (n_bits != other.n_bits)
         return false;
     if (index_to_weight.size() != other.index_to_weight.size())
         return false;
-    for (const auto& [index, weight] : index_to_weight) {
-        auto it = other.index_to_weight.find(index);
-        if (it == other.index_to_weight.end())
-            return false;
-        if (std::abs(weight - it->second) > eps)
-            return false;
+    bool equal = true;
+    if (!is_dense() && !other.is_dense()) {
+        auto it = other.index_to_weight.entries().begin();
+        for (const auto& [index, weight] : index_to_weight.entries()) {
+            if (index != it->first || std::abs(weight - it->second) > eps)
+                return false;
+            ++it;
+        }
+        return true;
     }
-    return true;
+    index_to_weight.for_each([&](index_t index, double weight) {
+        if (std::abs(weight - other.index_to_weight.get(index)) > eps || other.index_to_weight.get(index) == 0)
+            equal = false;
+    });
+    return equal;
 }
 
 std::vector<uint32_t> QRState::get_supports() const {
     std::unordered_set<uint32_t> support_set;
-    for (const auto& [index, weight] : index_to_weight)
+    index_to_weight.for_each([&](index_t index, double) {
         for (uint32_t i = 0; i < n_bits; i++)
-            if (index & (1 << i))
+            if ((index >> i) & 1)
                 support_set.insert(i);
+    });
     return std::vector<uint32_t>(support_set.begin(), support_set.end());
 }
 
-std::vector<uint64_t> QRState::get_qubit_signatures() const {
-    std::vector<uint64_t> signatures(n_bits, 0);
-    for (const auto& [index, weight] : index_to_weight) {
-        for (uint32_t j = 0; j < n_bits; j++) {
-            signatures[j] = (signatures[j] << 1) | ((index >> j) & 1);
+std::vector<Signature> QRState::get_qubit_signatures() const {
+    const std::size_t      n_words = (cardinality() + 63) / 64;
+    std::vector<Signature> signatures(n_bits, Signature{std::vector<uint64_t>(n_words, 0)});
+    std::vector<index_t>   block;
+    std::size_t            word = 0;
+    block.reserve(64);
+    auto flush = [&]() {
+        for (uint32_t base = 0; base < n_bits; base += 64) {
+            uint64_t rows[64] = {};
+            for (std::size_t i = 0; i < block.size(); i++)
+                rows[i] = (uint64_t)(block[i] >> base);
+            transpose64(rows);
+            for (uint32_t j = base; j < std::min(n_bits, base + 64); j++)
+                signatures[j].words[word] = rows[j - base];
         }
-    }
+        block.clear();
+        word++;
+    };
+    index_to_weight.for_each([&](index_t index, double) {
+        block.push_back(index);
+        if (block.size() == 64)
+            flush();
+    });
+    if (!block.empty())
+        flush();
     return signatures;
 }
 
-uint64_t QRState::get_const1_signature() const {
-    return (1ull << cardinality()) - 1;
+Signature QRState::get_const1_signature() const {
+    const std::size_t m = cardinality();
+    Signature         const1{std::vector<uint64_t>((m + 63) / 64, ~0ull)};
+    if (m % 64)
+        const1.words.back() = (1ull << (m % 64)) - 1;
+    return const1;
 }
 
 std::optional<double> QRState::get_ap_ry_angles(uint32_t qubit_index) const {
     std::optional<double> theta;
-    for (const auto& [index, weight] : index_to_weight) {
-        uint32_t reversed_index = index ^ (1 << qubit_index);
-        if (index_to_weight.find(reversed_index) == index_to_weight.end()) {
-            return std::nullopt;
-        }
-        uint32_t index0 = index & ~(1 << qubit_index);
-        uint32_t index1 = index | (1 << qubit_index);
-        auto     it0    = index_to_weight.find(index0);
-        auto     it1    = index_to_weight.find(index1);
-        if (it0 == index_to_weight.end() || it1 == index_to_weight.end()) {
-            return std::nullopt;
+    bool                  valid = true;
+    for_each_pair(index_to_weight, qubit_index, [&](index_t, const double* weight0, const double* weight1) {
+        if (!valid)
+            return;
+        if (!weight0 || !weight1) {
+            valid = false;
+            return;
         }
-        double weight0 = it0->second;
-        double weight1 = it1->second;
-        double _theta  = 2.0 * std::atan(weight1 / weight0);
-        if (!theta.has_value()) {
+        double _theta = 2.0 * std::atan(*weight1 / *weight0);
+        if (!theta.has_value())
             theta = _theta;
-        } else if (std::abs(theta.value() - _theta) < 1e-10) {
-            continue;
-        } else {
-            return std::nullopt;
-        }
-    }
+        else if (!(std::abs(theta.value() - _theta) < 1e-10))
+            valid = false;
+    });
+    if (!valid)
+        return std::nullopt;
     return theta;
 }
 QRState ground_rstate(uint32_t n_bits) {
-    std::map<uint32_t, double> index_to_weight;
-    index_to_weight[0] = 1.0;
+    WeightMap<double> index_to_weight;
+    index_to_weight.push_back(0, 1.0);
     return QRState(index_to_weight, n_bits);
 }
 QRState dicke_state(uint32_t n, uint32_t k) {
-    std::map<uint32_t, double> index_to_weight;
-    double                     total_weight = 0;
-    for (uint32_t i = 0; i < (1 << n); i++) {
+    WeightMap<double> index_to_weight;
+    double            total_weight = 0;
+    for (index_t i = 0; i < (index_t(1) << n); i++) {
         uint32_t count = 0;
         for (uint32_t j = 0; j < n; j++)
             count += (i >> j) & 1;
         if (count == k) {
-            index_to_weight[i] = 1.0;
+            index_to_weight.push_back(i, 1.0);
             total_weight += 1.0;
         }
     }
@@ -158,12 +218,11 @@ QRState dicke_state(uint32_t n, uint32_t k) {
 }
 
 QRState random_rstate(uint32_t n_bits, uint32_t cardinality, uint64_t seed) {
-    if (n_bits >= 32)
-        throw std::invalid_argument("random_rstate: n_bits must be < 32 (index type is uint32_t)");
+    if (n_bits > index_bits)
+        throw std::invalid_argument("random_rstate: n_bits exceeds the width of index_t");
     if (cardinality == 0)
         throw std::invalid_argument("random_rstate: cardinality must be >= 1");
-    const uint64_t dim = 1ull << n_bits;
-    if ((uint64_t)cardinality > dim)
+    if (n_bits < 32 && cardinality > (1u << n_bits))
         throw std::invalid_argument("random_rstate: cardinality exceeds Hilbert space dimension");
 
     uint64_t actual_seed = seed;
@@ -172,21 +231,32 @@ QRState random_rstate(uint32_t n_bits, uint32_t cardinality, uint64_t seed) {
         actual_seed = ((uint64_t)rd() << 32) ^ (uint64_t)rd();
     }
     std::mt19937_64                         rng(actual_seed ? actual_seed : 1);
-    std::uniform_int_distribution<uint32_t> pick_index(0u, (uint32_t)(dim - 1));
+    std::uniform_int_distribution<uint32_t> pick_index32(0u, (uint32_t)index_mask(std::min(n_bits, 31u)));
     std::normal_distribution<double>        pick_weight(0.0, 1.0);
+    auto                                    pick_index = [&]() {
+        if (n_bits < 32)
+            return (index_t)pick_index32(rng);
+        index_t index = (index_t)rng();
+        if constexpr (index_bits > 64)
+            for (uint32_t i = 64; i < n_bits; i += 64)
+                index = (index << 32 << 32) | (index_t)rng();
+        return index & index_mask(n_bits);
+    };
 
-    std::unordered_set<uint32_t> chosen;
+    std::unordered_set<index_t, IndexHash> chosen;
     while (chosen.size() < cardinality) {
-        chosen.insert(pick_index(rng));
+        chosen.insert(pick_index());
     }
 
-    std::map<uint32_t, double> index_to_weight;
-    double                     norm2 = 0.0;
-    for (uint32_t index : chosen) {
-        double w               = pick_weight(rng);
-        index_to_weight[index] = w;
+    WeightMap<double> index_to_weight;
+    double            norm2 = 0.0;
+    index_to_weight.reserve(cardinality);
+    for (index_t index : chosen) {
+        double w = pick_weight(rng);
+        index_to_weight.push_back(index, w);
         norm2 += w * w;
     }
+    std::sort(index_to_weight.begin(), index_to_weight.end());
 
     if (norm2 <= 0.0) {
         auto it = index_to_weight.begin();
@@ -209,7 +279,7 @@ std::ostream& operator<<(std::ostream& os, const QState& obj) {
         auto weight = it->second;
         os << weight << "*|";
         for (uint32_t i = 0; i < obj.n_bits; i++)
-            os << ((index >> i) & 1);
+            os << (int)((index >> i) & 1);
         os << ">";
         if (std::next(it) != obj.index_to_weight.end())
             os << " + ";
@@ -218,8 +288,8 @@ std::ostream& operator<<(std::ostream& os, const QState& obj) {
 }
 
 QState ground_state(uint32_t n_bits) {
-    std::map<uint32_t, std::complex<double>> index_to_weight;
-    index_to_weight[0] = 1.0;
+    WeightMap<std::complex<double>> index_to_weight;
+    index_to_weight.push_back(0, 1.0);
     return QState(index_to_weight, n_bits);
 }
 } // namespace xyz
\ No newline at end of file
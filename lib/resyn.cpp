@@ -46,7 +46,7 @@ bool gaussian_elimination(std::vector<std::vector<int>>& R, std::vector<double>&
     b.resize(n);
     return true;
 }
-using RLUT = std::vector<std::pair<uint32_t, std::pair<double, double>>>;
+using RLUT = std::vector<std::pair<index_t, std::pair<double, double>>>;
 using CXT  = std::vector<std::pair<int, bool>>;
 using RSOL = std::vector<double>;
 void enumerate_cnot_templates(std::vector<CXT>& templates, const std::vector<uint32_t>& controls, uint32_t n_cnots,
@@ -77,7 +77,7 @@ std::optional<std::pair<RSOL, CXT>> rotation_solver(const RLUT& rlut, const std:
             std::vector<std::vector<int>> R; /* Polar Matrix */
             std::vector<double>           b; /* RHS */
             for (uint32_t i = 0; i < m; i++) {
-                uint32_t         index    = rlut[i].first;
+                index_t          index    = rlut[i].first;
                 int              polarity = 1;
                 std::vector<int> row;
                 row.push_back(polarity);
@@ -117,7 +117,7 @@ void resyn_impl(const QCircuit& circuit, QCircuit& new_circuit, const QRState& i
         if (_gate->target != target)
             break;
         initial_cost += _gate->num_cnots();
-        new_state = (*_gate)(new_state);
+        _gate->apply(new_state);
     }
 
     auto initial_ry   = initial_state.to_ry_table(target);
@@ -140,10 +140,10 @@ void resyn_impl(const QCircuit& circuit, QCircuit& new_circuit, const QRState& i
         for (uint32_t i = 0; i < n_cnots; i++) {
             auto control = config[i].first;
             auto phase   = config[i].second;
-            new_circuit.add_gate(std::make_shared<RY>(target, rotation_angles[i]));
-            new_circuit.add_gate(std::make_shared<CX>(control, phase, target));
+            new_circuit.add_gate(make_gate<RY>(target, rotation_angles[i]));
+            new_circuit.add_gate(make_gate<CX>(control, phase, target));
         }
-        new_circuit.add_gate(std::make_shared<RY>(target, rotation_angles[n_cnots]));
+        new_circuit.add_gate(make_gate<RY>(target, rotation_angles[n_cnots]));
     } else {
         for (uint32_t i = pos; i < new_pos; i++)
             new_circuit.add_gate(circuit.pGates[i]);
@@ -0,0 +1,45 @@
+#include "sim-session.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace xyz {
+
+SimSession::SimSession(const QRState& initial, uint32_t interval)
+    : initial(initial), interval(std::max(1u, interval)) {}
+
+QRState SimSession::run(const GateList& list) {
+    const uint32_t        n = list.size();
+    std::vector<uint64_t> prefix(n + 1);
+    prefix[0] = splitmix64(initial.n_bits);
+    for (uint32_t i = 0; i < n; i++)
+        prefix[i + 1] = splitmix64(prefix[i] ^ list.hash_of(list.ops[i]));
+
+    auto stored = [&](uint32_t length) -> const Checkpoint* {
+        auto it = checkpoints.find(prefix[length]);
+        return it != checkpoints.end() && it->second.length == length ? &it->second : nullptr;
+    };
+    /* the whole list may be a rerun; otherwise the last interval boundary that is still stored */
+    uint32_t start = stored(n) ? n : n / interval * interval;
+    while (start > 0 && !stored(start))
+        start -= interval;
+    QRState state = start > 0 ? stored(start)->state : initial;
+
+    /* only the checkpoints on this list's path are kept, which bounds the session to n / interval states */
+    std::unordered_map<uint64_t, Checkpoint> kept;
+    for (uint32_t length = interval; length <= start; length += interval)
+        if (const Checkpoint* checkpoint = stored(length))
+            kept.emplace(prefix[length], *checkpoint);
+    for (uint32_t i = start; i < n; i++) {
+        list.apply(list.ops[i], state);
+        if ((i + 1) % interval == 0)
+            kept.insert_or_assign(prefix[i + 1], Checkpoint{i + 1, state});
+    }
+    kept.insert_or_assign(prefix[n], Checkpoint{n, state});
+    checkpoints = std::move(kept);
+    resumed     = start;
+    applied     = n - start;
+    return state;
+}
+
+} // namespace xyz
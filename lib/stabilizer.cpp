@@ -0,0 +1,420 @@
+#include "stabilizer.hpp"
+
+#include "qgate.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace xyz {
+namespace {
+inline uint32_t popcount(index_t x) {
+    if constexpr (sizeof(index_t) > 8)
+        return __builtin_popcountll((uint64_t)x) + __builtin_popcountll((uint64_t)(x >> 32 >> 32));
+    else
+        return __builtin_popcountll((uint64_t)x);
+}
+
+inline uint32_t parity(index_t x) {
+    return popcount(x) & 1u;
+}
+
+inline bool bit(index_t x, uint32_t j) {
+    return (x >> j) & 1u;
+}
+
+inline index_t unit(uint32_t j) {
+    return index_t(1) << j;
+}
+
+inline std::complex<double> i_pow(uint32_t k) {
+    static const std::complex<double> powers[4] = {{1.0, 0.0}, {0.0, 1.0}, {-1.0, 0.0}, {0.0, -1.0}};
+    return powers[k % 4];
+}
+} // namespace
+
+CHForm::CHForm(uint32_t n_bits) : n_bits(n_bits), F(n_bits), G(n_bits), M(n_bits, 0), gamma(n_bits, 0) {
+    if (n_bits > index_bits)
+        throw std::runtime_error("CH-form supports at most " + std::to_string(index_bits) + " qubits");
+    for (uint32_t p = 0; p < n_bits; p++)
+        F[p] = G[p] = unit(p);
+}
+
+void CHForm::apply_s(uint32_t q) {
+    M[q] ^= G[q];
+    gamma[q] = (gamma[q] + 3) % 4;
+}
+
+void CHForm::apply_sdg(uint32_t q) {
+    M[q] ^= G[q];
+    gamma[q] = (gamma[q] + 1) % 4;
+}
+
+void CHForm::apply_z(uint32_t q) {
+    gamma[q] = (gamma[q] + 2) % 4;
+}
+
+void CHForm::apply_x(uint32_t q) {
+    apply_h(q);
+    apply_z(q);
+    apply_h(q);
+}
+
+void CHForm::apply_cx(uint32_t ctrl, uint32_t target) {
+    gamma[ctrl] = (gamma[ctrl] + gamma[target] + 2 * parity(M[ctrl] & F[target])) % 4;
+    G[target] ^= G[ctrl];
+    F[ctrl] ^= F[target];
+    M[ctrl] ^= M[target];
+}
+
+void CHForm::apply_cz(uint32_t q, uint32_t r) {
+    M[q] ^= G[r];
+    M[r] ^= G[q];
+}
+
+void CHForm::apply_h(uint32_t q) {
+    const index_t  t     = s ^ (G[q] & v);
+    const index_t  u     = s ^ (F[q] & ~v) ^ (M[q] & v);
+    const uint32_t alpha = parity(G[q] & ~v & s);
+    const uint32_t beta  = parity(M[q] & ~v & s) ^ parity(F[q] & v & M[q]) ^ parity(F[q] & v & s);
+    update_sum(t, u, (gamma[q] + 2 * (alpha + beta)) % 4, alpha);
+}
+
+/* Proposition 4: i^alpha U_H (|t> + i^delta |u>) rewritten as omega' U_C' U_H' |s'> */
+void CHForm::update_sum(index_t t, index_t u, uint32_t delta, uint32_t alpha) {
+    const double sign = alpha ? -1.0 : 1.0;
+    if (t == u) {
+        s = t;
+        omega *= sign * constants::sqrt2_inv * (1.0 + i_pow(delta));
+        return;
+    }
+    const index_t diff = t ^ u, set0 = ~v & diff, set1 = v & diff;
+    uint32_t      q    = 0;
+    if (set0) {
+        while (!bit(set0, q))
+            q++;
+        for (uint32_t i = 0; i < n_bits; i++) {
+            if (i != q && bit(set0, i))
+                cx_right(q, i);
+            if (bit(set1, i))
+                cz_right(q, i);
+        }
+    } else {
+        while (!bit(set1, q))
+            q++;
+        for (uint32_t i = q + 1; i < n_bits; i++)
+            if (bit(set1, i))
+                cx_right(i, q);
+    }
+    /* y and z now differ only at q, leaving the one-qubit case H^v (|y> + i^delta |z>) = w S^a H^b |c> */
+    const index_t        y  = bit(t, q) ? u ^ unit(q) : t;
+    const bool           vq = bit(v, q), yq = bit(y, q);
+    std::complex<double> w;
+    bool                 a, b, c;
+    if (!vq) {
+        const uint32_t delta2 = yq ? (4 - delta) % 4 : delta;
+        w                     = i_pow(delta * yq);
+        a                     = delta2 & 1u;
+        b                     = true;
+        c                     = delta2 >> 1;
+    } else if (!(delta & 1u)) {
+        a = b = false;
+        c     = delta >> 1;
+        w     = (c && yq) ? -1.0 : 1.0;
+    } else {
+        w = constants::sqrt2_inv * (1.0 + i_pow(delta));
+        a = b = true;
+        c     = !((delta >> 1) ^ yq);
+    }
+    s = c ? y | unit(q) : y & ~unit(q);
+    omega *= sign * w;
+    if (a)
+        s_right(q);
+    v = b ? v | unit(q) : v & ~unit(q);
+}
+
+void CHForm::cx_right(uint32_t q, uint32_t r) {
+    for (uint32_t p = 0; p < n_bits; p++) {
+        G[p] ^= index_t(bit(G[p], r)) << q;
+        F[p] ^= index_t(bit(F[p], q)) << r;
+        M[p] ^= index_t(bit(M[p], r)) << q;
+    }
+}
+
+void CHForm::cz_right(uint32_t q, uint32_t r) {
+    for (uint32_t p = 0; p < n_bits; p++) {
+        const bool fq = bit(F[p], q), fr = bit(F[p], r);
+        M[p] ^= (index_t(fr) << q) ^ (index_t(fq) << r);
+        gamma[p] = (gamma[p] + 2 * (fq && fr)) % 4;
+    }
+}
+
+void CHForm::s_right(uint32_t q) {
+    for (uint32_t p = 0; p < n_bits; p++) {
+        const bool fq = bit(F[p], q);
+        M[p] ^= index_t(fq) << q;
+        gamma[p] = (gamma[p] + 4 - fq) % 4;
+    }
+}
+
+/* <x| U_C = <0| (U_C^-1 X^x U_C) U_C^-1 up to the stored phases, then a product over single qubits */
+std::complex<double> CHForm::amplitude(index_t x) const {
+    uint32_t mu = 0;
+    index_t  u  = 0;
+    for (uint32_t p = 0; p < n_bits; p++) {
+        if (!bit(x, p))
+            continue;
+        mu += gamma[p];
+        u ^= F[p];
+        mu += 2 * parity(M[p] & u);
+    }
+    if (~v & (u ^ s) & index_mask(n_bits))
+        return 0.0;
+    const double sign = parity(v & u & s) ? -1.0 : 1.0;
+    return omega * std::pow(constants::sqrt2_inv, popcount(v)) * i_pow(mu) * sign;
+}
+
+namespace {
+enum class Step : uint8_t { H, S, Sdg, Z, X, CX, T, Tdg };
+
+struct Instr {
+    Step     kind;
+    uint32_t a, b = 0;
+};
+
+std::vector<Instr> lower_clifford_t(const GateList& list) {
+    std::vector<Instr> prog;
+    auto               controlled_x = [&](uint32_t ctrl, bool phase, uint32_t target) {
+        if (!phase)
+            prog.push_back({Step::X, ctrl});
+        prog.push_back({Step::CX, ctrl, target});
+        if (!phase)
+            prog.push_back({Step::X, ctrl});
+    };
+    for (const auto& op : list.ops) {
+        const uint32_t t = op.target();
+        switch (op.kind) {
+        case GateKind::X:
+            prog.push_back({Step::X, t});
+            break;
+        case GateKind::Z:
+            prog.push_back({Step::Z, t});
+            break;
+        case GateKind::H:
+            prog.push_back({Step::H, t});
+            break;
+        case GateKind::S:
+            prog.push_back({Step::S, t});
+            break;
+        case GateKind::Sdg:
+            prog.push_back({Step::Sdg, t});
+            break;
+        case GateKind::T:
+            prog.push_back({Step::T, t});
+            break;
+        case GateKind::Tdg:
+            prog.push_back({Step::Tdg, t});
+            break;
+        case GateKind::CX:
+            controlled_x(op.qbits[1], op.phase, t);
+            break;
+        case GateKind::CCX: {
+            const uint32_t c1 = op.qbits[1], c2 = op.qbits[2];
+            for (uint32_t c : {c1, c2})
+                if (!bit(op.ctrl_value, c))
+                    prog.push_back({Step::X, c});
+            /* the standard seven-T Toffoli network */
+            prog.insert(prog.end(), {{Step::H, t},
+                                     {Step::CX, c2, t},
+                                     {Step::Tdg, t},
+                                     {Step::CX, c1, t},
+                                     {Step::T, t},
+                                     {Step::CX, c2, t},
+                                     {Step::Tdg, t},
+                                     {Step::CX, c1, t},
+                                     {Step::T, c2},
+                                     {Step::T, t},
+                                     {Step::H, t},
+                                     {Step::CX, c1, c2},
+                                     {Step::T, c1},
+                                     {Step::Tdg, c2},
+                                     {Step::CX, c1, c2}});
+            for (uint32_t c : {c1, c2})
+                if (!bit(op.ctrl_value, c))
+                    prog.push_back({Step::X, c});
+            break;
+        }
+        default:
+            throw std::runtime_error("stabilizer simulation supports only Clifford+T gates, got " +
+                                     list.to_string(op));
+        }
+    }
+    return prog;
+}
+
+/* merges the diagonal phases between two non-diagonal gates on a qubit into eighth turns, so runs
+ * like T T or T Tdg cost no branching; CX controls commute with them and do not interrupt a run */
+std::vector<Instr> fold_phases(const std::vector<Instr>& prog, uint32_t n_bits) {
+    std::vector<Instr>   out;
+    std::vector<uint8_t> eighths(n_bits, 0);
+    auto                 flush = [&](uint32_t q) {
+        const uint8_t k = eighths[q];
+        eighths[q]      = 0;
+        if (k == 4 || k == 5)
+            out.push_back({Step::Z, q});
+        else if (k == 2 || k == 3)
+            out.push_back({Step::S, q});
+        else if (k == 6)
+            out.push_back({Step::Sdg, q});
+        if (k == 7)
+            out.push_back({Step::Tdg, q});
+        else if (k & 1u)
+            out.push_back({Step::T, q});
+    };
+    for (const auto& instr : prog) {
+        switch (instr.kind) {
+        case Step::T:
+        case Step::Tdg:
+        case Step::S:
+        case Step::Sdg:
+        case Step::Z: {
+            const uint8_t turn = instr.kind == Step::T     ? 1
+                                 : instr.kind == Step::Tdg ? 7
+                                 : instr.kind == Step::S   ? 2
+                                 : instr.kind == Step::Sdg ? 6
+                                                           : 4;
+            eighths[instr.a]   = (eighths[instr.a] + turn) % 8;
+            break;
+        }
+        case Step::CX:
+            flush(instr.b);
+            out.push_back(instr);
+            break;
+        default:
+            flush(instr.a);
+            out.push_back(instr);
+        }
+    }
+    for (uint32_t q = 0; q < n_bits; q++)
+        flush(q);
+    return out;
+}
+
+void apply_clifford(CHForm& state, const Instr& instr) {
+    switch (instr.kind) {
+    case Step::H:
+        state.apply_h(instr.a);
+        break;
+    case Step::S:
+        state.apply_s(instr.a);
+        break;
+    case Step::Sdg:
+        state.apply_sdg(instr.a);
+        break;
+    case Step::Z:
+        state.apply_z(instr.a);
+        break;
+    case Step::X:
+        state.apply_x(instr.a);
+        break;
+    case Step::CX:
+        state.apply_cx(instr.a, instr.b);
+        break;
+    default:
+        break;
+    }
+}
+
+/* T = alpha I + beta S and Tdg = conj(alpha) I + conj(beta) Sdg */
+const std::complex<double> t_beta  = (std::polar(1.0, M_PI / 4.0) - 1.0) / std::complex<double>(-1.0, 1.0);
+const std::complex<double> t_alpha = 1.0 - t_beta;
+
+template <typename Leaf>
+void for_each_branch(const std::vector<Instr>& prog, std::size_t i, CHForm state, std::complex<double> coef,
+                     Leaf& leaf) {
+    for (; i < prog.size(); i++) {
+        const Instr& instr = prog[i];
+        if (instr.kind == Step::T || instr.kind == Step::Tdg) {
+            const bool dagger = instr.kind == Step::Tdg;
+            CHForm     branch = state;
+            if (dagger)
+                branch.apply_sdg(instr.a);
+            else
+                branch.apply_s(instr.a);
+            for_each_branch(prog, i + 1, branch, coef * (dagger ? std::conj(t_beta) : t_beta), leaf);
+            coef *= dagger ? std::conj(t_alpha) : t_alpha;
+            continue;
+        }
+        apply_clifford(state, instr);
+    }
+    leaf(coef, state);
+}
+
+template <typename Leaf> void sum_over_cliffords(const GateList& list, const stabilizer_params& params, Leaf&& leaf) {
+    const std::vector<Instr> prog = fold_phases(lower_clifford_t(list), list.num_qbits);
+    const uint32_t           n_t  = std::count_if(prog.begin(), prog.end(), [](const Instr& instr) {
+        return instr.kind == Step::T || instr.kind == Step::Tdg;
+    });
+    if (params.n_samples == 0) {
+        if (n_t > stabilizer_max_exact_t)
+            throw std::runtime_error("T-count " + std::to_string(n_t) +
+                                     " is too large for the exact stabilizer sum; set n_samples");
+        for_each_branch(prog, 0, CHForm(list.num_qbits), 1.0, leaf);
+        return;
+    }
+    std::mt19937_64 rng(params.seed);
+    const double    scale = 1.0 / params.n_samples;
+    for (uint32_t sample = 0; sample < params.n_samples; sample++) {
+        CHForm               state(list.num_qbits);
+        std::complex<double> coef = scale;
+        for (const auto& instr : prog) {
+            if (instr.kind != Step::T && instr.kind != Step::Tdg) {
+                apply_clifford(state, instr);
+                continue;
+            }
+            const bool dagger = instr.kind == Step::Tdg;
+            /* |alpha| == |beta|, so both branches are equally likely and the weight doubles */
+            if (rng() & 1u) {
+                if (dagger)
+                    state.apply_sdg(instr.a);
+                else
+                    state.apply_s(instr.a);
+                coef *= 2.0 * (dagger ? std::conj(t_beta) : t_beta);
+            } else {
+                coef *= 2.0 * (dagger ? std::conj(t_alpha) : t_alpha);
+            }
+        }
+        leaf(coef, state);
+    }
+}
+} // namespace
+
+uint32_t t_count(const GateList& list) {
+    uint32_t count = 0;
+    for (const auto& op : list.ops)
+        count += op.kind == GateKind::T || op.kind == GateKind::Tdg ? 1 : op.kind == GateKind::CCX ? 7 : 0;
+    return count;
+}
+
+std::vector<std::complex<double>> stabilizer_amplitudes(const GateList& list, const std::vector<index_t>& xs,
+                                                        const stabilizer_params& params) {
+    std::vector<std::complex<double>> result(xs.size(), 0.0);
+    sum_over_cliffords(list, params, [&](std::complex<double> coef, const CHForm& state) {
+        for (std::size_t k = 0; k < xs.size(); k++)
+            result[k] += coef * state.amplitude(xs[k]);
+    });
+    return result;
+}
+
+std::complex<double> stabilizer_overlap(const GateList& list, const QRState& target, const stabilizer_params& params) {
+    std::complex<double> result = 0.0;
+    sum_over_cliffords(list, params, [&](std::complex<double> coef, const CHForm& state) {
+        target.index_to_weight.for_each(
+            [&](index_t index, double weight) { result += coef * weight * state.amplitude(index); });
+    });
+    return result;
+}
+
+} // namespace xyz
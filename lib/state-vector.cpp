@@ -0,0 +1,417 @@
+#include "state-vector.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define XYZ_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace xyz {
+namespace {
+/* pairs below which a gate is not worth handing to the workers */
+constexpr std::size_t grain = std::size_t(1) << 14;
+
+/* the kernels see the amplitudes as 2^m rows of `width` doubles; a complex vector is the same array with
+ * every qubit moved up one lane and a batch keeps one column per state, so real 2x2 gates on all three
+ * layouts share one code path */
+struct Lanes {
+    double*     d;
+    std::size_t size;
+    uint32_t    shift;
+    std::size_t width = 1;
+
+    std::size_t bit(uint32_t qubit) const { return std::size_t(1) << (qubit + shift); };
+    std::size_t mask(index_t m) const { return (std::size_t)m << shift; };
+};
+
+/* lane of the |0> half of pair i: i with a zero inserted at the target bit */
+inline std::size_t pair_base(std::size_t i, std::size_t bit) {
+    return ((i & ~(bit - 1)) << 1) | (i & (bit - 1));
+}
+
+inline void rotate1(double* a, double* b, const std::array<double, 4>& c) {
+    const double w0 = *a, w1 = *b;
+    *a              = c[0] * w0 + c[2] * w1;
+    *b              = c[1] * w0 + c[3] * w1;
+}
+
+/* the vector kernels are compiled for their instruction set regardless of the build flags and picked
+ * once at run time from the host CPU; rotate4 takes four consecutive pairs whose lanes a and b are 32-byte
+ * aligned since the pair base is a multiple of 4 lanes, rotate_row a batch row of w lanes, w a multiple of 4 */
+struct Scalar {
+    static void rotate4(double* a, double* b, const std::array<double, 4>& c) {
+        for (int k = 0; k < 4; k++)
+            rotate1(a + k, b + k, c);
+    }
+    static void rotate_row(double* a, double* b, std::size_t w, const std::array<double, 4>& c) {
+        for (std::size_t k = 0; k < w; k++)
+            rotate1(a + k, b + k, c);
+    }
+};
+
+#ifdef XYZ_X86_KERNELS
+struct Avx2 {
+    __attribute__((target("avx2"))) static void rotate4(double* a, double* b, const std::array<double, 4>& c) {
+        const __m256d w0 = _mm256_load_pd(a), w1 = _mm256_load_pd(b);
+        _mm256_store_pd(a, _mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(c[0]), w0), _mm256_mul_pd(_mm256_set1_pd(c[2]), w1)));
+        _mm256_store_pd(b, _mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(c[1]), w0), _mm256_mul_pd(_mm256_set1_pd(c[3]), w1)));
+    }
+    __attribute__((target("avx2"))) static void rotate_row(double* a, double* b, std::size_t w,
+                                                           const std::array<double, 4>& c) {
+        for (std::size_t k = 0; k < w; k += 4)
+            rotate4(a + k, b + k, c);
+    }
+};
+
+/* eight lanes at a time along batch rows; rows are only 32-byte aligned, so the loads are unaligned */
+struct Avx512 : Avx2 {
+    __attribute__((target("avx512f"))) static void rotate_row(double* a, double* b, std::size_t w,
+                                                              const std::array<double, 4>& c) {
+        std::size_t k = 0;
+        for (; k + 8 <= w; k += 8) {
+            const __m512d w0 = _mm512_loadu_pd(a + k), w1 = _mm512_loadu_pd(b + k);
+            _mm512_storeu_pd(a + k, _mm512_add_pd(_mm512_mul_pd(_mm512_set1_pd(c[0]), w0),
+                                                  _mm512_mul_pd(_mm512_set1_pd(c[2]), w1)));
+            _mm512_storeu_pd(b + k, _mm512_add_pd(_mm512_mul_pd(_mm512_set1_pd(c[1]), w0),
+                                                  _mm512_mul_pd(_mm512_set1_pd(c[3]), w1)));
+        }
+        if (k < w)
+            rotate4(a + k, b + k, c);
+    }
+};
+#endif
+
+enum class Isa : uint8_t { scalar, avx2, avx512 };
+
+Isa host_isa() {
+#ifdef XYZ_X86_KERNELS
+    static const Isa isa = __builtin_cpu_supports("avx512f") ? Isa::avx512
+                           : __builtin_cpu_supports("avx2")  ? Isa::avx2
+                                                              : Isa::scalar;
+    return isa;
+#else
+    return Isa::scalar;
+#endif
+}
+
+/* pairs [begin, end) of one pass; always inlined so the kernels inline into each instruction set's copy */
+template <typename Kernel, typename Coef>
+__attribute__((always_inline)) inline void pair_range(const Lanes& v, std::size_t bit, std::size_t step, Coef& coef_at,
+                                                      std::size_t begin, std::size_t end) {
+    const std::size_t w = v.width;
+    for (std::size_t i = begin; i < end; i++) {
+        const std::size_t j = pair_base(i * step, bit);
+        const auto*       c = coef_at(j);
+        if (!c)
+            continue;
+        if (step == 4)
+            Kernel::rotate4(v.d + j, v.d + j + bit, *c);
+        else if (w == 1)
+            rotate1(v.d + j, v.d + j + bit, *c);
+        else
+            Kernel::rotate_row(v.d + j * w, v.d + (j + bit) * w, w, *c);
+    }
+}
+
+#ifdef XYZ_X86_KERNELS
+template <typename Coef>
+__attribute__((target("avx2"))) void pair_range_avx2(const Lanes& v, std::size_t bit, std::size_t step, Coef& coef_at,
+                                                     std::size_t begin, std::size_t end) {
+    pair_range<Avx2>(v, bit, step, coef_at, begin, end);
+}
+
+template <typename Coef>
+__attribute__((target("avx512f"))) void pair_range_avx512(const Lanes& v, std::size_t bit, std::size_t step,
+                                                          Coef& coef_at, std::size_t begin, std::size_t end) {
+    pair_range<Avx512>(v, bit, step, coef_at, begin, end);
+}
+#endif
+
+/* one pass over all pairs of `target`; coef_at(lane) gives the matrix of the pair or nullptr to skip it.
+ * With `wide` the caller guarantees coef_at is constant over each aligned group of four lanes; rows of a
+ * batch are a multiple of four wide and are rotated across the whole row */
+template <typename Coef>
+void pair_pass(const Lanes& v, uint32_t target, bool wide, Coef&& coef_at, ThreadPool& pool) {
+    const std::size_t bit  = v.bit(target);
+    const std::size_t step = v.width == 1 && wide && bit >= 4 ? 4 : 1;
+    const Isa         isa  = host_isa();
+    auto              pass = [&](std::size_t begin, std::size_t end) {
+#ifdef XYZ_X86_KERNELS
+        if (isa == Isa::avx512)
+            return pair_range_avx512(v, bit, step, coef_at, begin, end);
+        if (isa == Isa::avx2)
+            return pair_range_avx2(v, bit, step, coef_at, begin, end);
+#endif
+        pair_range<Scalar>(v, bit, step, coef_at, begin, end);
+    };
+    pool.parallel_for(v.size / 2 / step, std::max<std::size_t>(1, grain / step / v.width), pass);
+}
+
+void masked_pass(const Lanes& v, uint32_t target, const std::array<double, 4>& c, index_t ctrl_mask,
+                 index_t ctrl_value, ThreadPool& pool) {
+    const std::size_t mask = v.mask(ctrl_mask), value = v.mask(ctrl_value);
+    pair_pass(
+        v, target, (mask & 3) == 0, [&](std::size_t j) { return (j & mask) == value ? &c : nullptr; }, pool);
+}
+
+void multiplexed_pass(const Lanes& v, const std::vector<uint32_t>& ctrls, uint32_t target,
+                      const std::vector<double>& angles, const bool reverse, ThreadPool& pool) {
+    const double                       sign = reverse ? -1.0 : 1.0;
+    std::vector<std::array<double, 4>> table(angles.size());
+    for (std::size_t i = 0; i < angles.size(); i++) {
+        const double c = std::cos(angles[i] / 2), s = sign * std::sin(angles[i] / 2);
+        table[i]       = {c, s, -s, c};
+    }
+    bool wide = true;
+    for (uint32_t ctrl : ctrls)
+        wide = wide && ctrl + v.shift >= 2;
+    pair_pass(
+        v, target, wide,
+        [&](std::size_t j) {
+            const uint32_t i = gather_bits((index_t)(j >> v.shift), ctrls);
+            return i < table.size() ? &table[i] : nullptr;
+        },
+        pool);
+}
+
+void phase_pass(std::complex<double>* d, std::size_t size, uint32_t target, std::complex<double> phase,
+                index_t ctrl_mask, index_t ctrl_value, ThreadPool& pool) {
+    const std::size_t bit = std::size_t(1) << target, mask = ctrl_mask, value = ctrl_value;
+    pool.parallel_for(size / 2, grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            const std::size_t j = pair_base(i, bit);
+            if ((j & mask) == value)
+                d[j | bit] *= phase;
+        }
+    });
+}
+
+/* same phases as the sparse path in gate-ir.cpp */
+std::complex<double> diagonal_phase(GateKind kind) {
+    switch (kind) {
+    case GateKind::T:
+        return std::polar(1.0, M_PI / 4.0);
+    case GateKind::Tdg:
+        return std::polar(1.0, -M_PI / 4.0);
+    case GateKind::S:
+        return {0.0, 1.0};
+    default:
+        return std::polar(1.0, -M_PI / 2.0);
+    }
+}
+
+/* every gate with real coefficients; S/Sdg have none and T/Tdg fall back to their real rotation */
+void apply_real(const Lanes& v, const GateList& list, const GateOp& op, const bool reverse, ThreadPool& pool) {
+    switch (op.kind) {
+    case GateKind::X:
+    case GateKind::CX:
+    case GateKind::CCX:
+        masked_pass(v, op.target(), {0.0, 1.0, 1.0, 0.0}, op.ctrl_mask, op.ctrl_value, pool);
+        break;
+    case GateKind::S:
+        throw std::runtime_error("S gate not supported in real-amplitude QRState simulation");
+    case GateKind::Sdg:
+        throw std::runtime_error("Sdg introduces complex phase; use QState simulation");
+    case GateKind::T:
+    case GateKind::Tdg:
+    case GateKind::H:
+    case GateKind::Z:
+    case GateKind::RY:
+    case GateKind::CRY:
+    case GateKind::MCRY:
+    case GateKind::Unitary: {
+        const auto& c = op.coef;
+        masked_pass(v, op.target(), reverse ? std::array<double, 4>{c[0], c[2], c[1], c[3]} : c, op.ctrl_mask,
+                    op.ctrl_value, pool);
+        break;
+    }
+    case GateKind::MCMY:
+    case GateKind::QROM_MCRY:
+        multiplexed_pass(v, list.ctrls_of(op), op.target(), list.params_of(op), reverse, pool);
+        break;
+    }
+}
+} // namespace
+
+template <typename T> StateVector<T>::StateVector(const WeightMap<T>& map, uint32_t n_bits) : n_bits(n_bits) {
+    if (n_bits > dense_engine_max_bits)
+        throw std::runtime_error("dense engine supports at most " + std::to_string(dense_engine_max_bits) + " qubits");
+    amplitudes.assign(std::size_t(1) << n_bits, T(0));
+    map.for_each([&](index_t index, const T& weight) { amplitudes[(std::size_t)index] = weight; });
+}
+
+template <typename T> WeightMap<T> StateVector<T>::to_weight_map(double eps) const {
+    WeightMap<T> map;
+    auto&        entries = map.edit().entries;
+    for (std::size_t index = 0; index < amplitudes.size(); index++)
+        if (std::abs(amplitudes[index]) >= eps)
+            entries.emplace_back((index_t)index, amplitudes[index]);
+    return map;
+}
+
+template <typename T>
+void StateVector<T>::apply(const GateList& list, const GateOp& op, ThreadPool& pool, const bool reverse) {
+    constexpr bool is_complex = !std::is_same_v<T, double>;
+    const Lanes    v{reinterpret_cast<double*>(amplitudes.data()), amplitudes.size() * (is_complex ? 2 : 1),
+                  is_complex ? 1u : 0u};
+    if constexpr (is_complex) {
+        switch (op.kind) {
+        case GateKind::T:
+        case GateKind::Tdg:
+        case GateKind::S:
+        case GateKind::Sdg: {
+            const std::complex<double> phase = diagonal_phase(op.kind);
+            phase_pass(amplitudes.data(), amplitudes.size(), op.target(), reverse ? std::conj(phase) : phase,
+                       op.ctrl_mask, op.ctrl_value, pool);
+            return;
+        }
+        default:
+            break;
+        }
+    }
+    apply_real(v, list, op, reverse, pool);
+}
+
+template <typename T> void StateVector<T>::apply(const PhasePolynomial& poly, ThreadPool& pool) {
+    if constexpr (std::is_same_v<T, double>) {
+        throw std::runtime_error("phase polynomials need complex amplitudes; use QState simulation");
+    } else if (!poly.permutes()) {
+        pool.parallel_for(amplitudes.size(), grain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++)
+                amplitudes[i] *= poly((index_t)i);
+        });
+    } else {
+        decltype(amplitudes) out(amplitudes.size());
+        const auto&          perm = poly.permutation();
+        pool.parallel_for(amplitudes.size(), grain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++)
+                out[(std::size_t)perm((index_t)i)] = amplitudes[i] * poly((index_t)i);
+        });
+        amplitudes.swap(out);
+    }
+}
+
+template class StateVector<double>;
+template class StateVector<std::complex<double>>;
+
+StateBatch::StateBatch(const std::vector<QRState>& states, uint32_t n_bits)
+    : n_bits(n_bits), batch(states.size()), width((states.size() + 3) / 4 * 4) {
+    if (n_bits > dense_engine_max_bits)
+        throw std::runtime_error("dense engine supports at most " + std::to_string(dense_engine_max_bits) + " qubits");
+    amplitudes.assign((std::size_t(1) << n_bits) * width, 0.0);
+    for (std::size_t k = 0; k < batch; k++)
+        states[k].index_to_weight.for_each(
+            [&](index_t index, const double& weight) { amplitudes[(std::size_t)index * width + k] = weight; });
+}
+
+QRState StateBatch::state(std::size_t k) const {
+    WeightMap<double> map;
+    auto&             entries = map.edit().entries;
+    for (std::size_t index = 0; index < (std::size_t(1) << n_bits); index++)
+        if (std::abs(amplitudes[index * width + k]) >= QRState::eps)
+            entries.emplace_back((index_t)index, amplitudes[index * width + k]);
+    return QRState(map, n_bits);
+}
+
+void StateBatch::apply(const GateList& list, const GateOp& op, ThreadPool& pool, const bool reverse) {
+    apply_real(Lanes{amplitudes.data(), std::size_t(1) << n_bits, 0, width}, list, op, reverse, pool);
+}
+
+/* dense pays 2^n per gate while sparse pays per nonzero, so dense wins once the support can
+ * fill most of the vector: every branching gate at most doubles it */
+bool prefer_dense(const GateList& list, uint32_t n_bits, std::size_t cardinality, uint32_t max_bits) {
+    if (n_bits < QRState::dense_min_bits || n_bits > std::min(max_bits, dense_engine_max_bits))
+        return false;
+    double support = std::log2((double)std::max<std::size_t>(cardinality, 1));
+    for (const auto& op : list.ops) {
+        switch (op.kind) {
+        case GateKind::X:
+        case GateKind::CX:
+        case GateKind::CCX:
+        case GateKind::Z:
+        case GateKind::T:
+        case GateKind::Tdg:
+        case GateKind::S:
+        case GateKind::Sdg:
+            break;
+        default:
+            support += 1.0;
+        }
+        if (support >= n_bits)
+            return true;
+    }
+    return false;
+}
+
+namespace {
+/* phase_run > 0 applies runs of that many diagonal and X/CX gates as one phase polynomial (complex only) */
+template <typename State>
+State simulate_dense_impl(const GateList& list, const State& state, uint32_t n_threads, uint32_t phase_run) {
+    using T = std::decay_t<decltype(state.index_to_weight.get(0))>;
+    std::unique_ptr<ThreadPool> own;
+    ThreadPool&                 pool = pool_for(n_threads, own);
+    StateVector<T>              vector(state.index_to_weight, std::max(state.n_bits, list.num_qbits));
+    for (std::size_t i = 0; i < list.size();) {
+        const std::size_t end = phase_run ? phase_run_end(list, i) : i;
+        if (end - i >= std::max<std::size_t>(phase_run, 2)) {
+            vector.apply(PhasePolynomial(list, i, end), pool);
+            i = end;
+        } else {
+            vector.apply(list, list.ops[i++], pool);
+        }
+    }
+    return State(vector.to_weight_map(State::eps), state.n_bits);
+}
+} // namespace
+
+QRState simulate_dense(const GateList& list, const QRState& state, uint32_t n_threads) {
+    QRState result = simulate_dense_impl(list, state, n_threads, 0);
+    result.update_storage();
+    return result;
+}
+
+QState simulate_dense(const GateList& list, const QState& state, uint32_t n_threads, uint32_t phase_run) {
+    return simulate_dense_impl(list, state, n_threads, phase_run);
+}
+
+std::vector<QRState> simulate_batch(const GateList& list, const std::vector<QRState>& states, uint32_t n_threads) {
+    uint32_t    n_bits  = list.num_qbits;
+    std::size_t support = 0;
+    for (const auto& state : states) {
+        n_bits  = std::max(n_bits, state.n_bits);
+        support = std::max(support, state.index_to_weight.size());
+    }
+    std::unique_ptr<ThreadPool> own;
+    ThreadPool&                 pool = pool_for(n_threads, own);
+    /* the rows hold 2^n_bits amplitudes per state, so they must fit the budget Auto uses for one state,
+     * and past dense_min_bits the states must be expected to fill up as well */
+    const uint32_t    budget = sim_params().dense_max_bits;
+    const std::size_t width  = (states.size() + 3) / 4 * 4;
+    const bool        dense  = n_bits <= budget && (std::size_t(1) << n_bits) * width <= (std::size_t(1) << budget) &&
+                       (n_bits < QRState::dense_min_bits || prefer_dense(list, n_bits, support, budget));
+    if (!dense) {
+        /* simulate each sparse state on its own, one per pool chunk */
+        std::vector<QRState> results(states.size());
+        pool.run((uint32_t)states.size(), [&](uint32_t k) { results[k] = simulate(list, states[k]); });
+        return results;
+    }
+    StateBatch batch(states, n_bits);
+    for (const auto& op : list.ops)
+        batch.apply(list, op, pool);
+    std::vector<QRState> results;
+    results.reserve(states.size());
+    for (std::size_t k = 0; k < states.size(); k++) {
+        QRState result = batch.state(k);
+        result.n_bits  = states[k].n_bits;
+        result.update_storage();
+        results.push_back(std::move(result));
+    }
+    return results;
+}
+
+} // namespace xyz
@@ -0,0 +1,112 @@
+#include "thread-pool.hpp"
+
+#include <memory>
+
+namespace xyz {
+
+ThreadPool::ThreadPool(uint32_t n_threads) {
+    if (n_threads == 0)
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    workers.reserve(n_threads - 1);
+    for (uint32_t i = 1; i < n_threads; i++)
+        workers.emplace_back([this, i] { worker(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start.notify_all();
+    for (auto& thread : workers)
+        thread.join();
+}
+
+void ThreadPool::run(uint32_t n_chunks, const std::function<void(uint32_t)>& job) {
+    bool idle = false;
+    if (workers.empty() || n_chunks <= 1 || !busy.compare_exchange_strong(idle, true)) {
+        for (uint32_t chunk = 0; chunk < n_chunks; chunk++)
+            job(chunk);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current        = &job;
+        this->n_chunks = n_chunks;
+        pending        = (uint32_t)workers.size();
+        generation++;
+    }
+    start.notify_all();
+    try {
+        for (uint32_t chunk = 0; chunk < n_chunks; chunk += size())
+            job(chunk);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!failure)
+            failure = std::current_exception();
+    }
+    /* the workers are always waited for, so the job outlives every call to it and the pool is idle again
+     * before the first exception is rethrown */
+    std::exception_ptr           error;
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+    current = nullptr;
+    std::swap(error, failure);
+    busy = false;
+    lock.unlock();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void ThreadPool::worker(uint32_t index) {
+    uint64_t seen = 0;
+    while (true) {
+        const std::function<void(uint32_t)>* job;
+        uint32_t                             chunks;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen   = generation;
+            job    = current;
+            chunks = n_chunks;
+        }
+        std::exception_ptr error;
+        try {
+            for (uint32_t chunk = index; chunk < chunks; chunk += size())
+                (*job)(chunk);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error && !failure)
+            failure = error;
+        if (--pending == 0)
+            done.notify_one();
+    }
+}
+
+namespace {
+std::unique_ptr<ThreadPool>& shared_slot() {
+    static std::unique_ptr<ThreadPool> pool = std::make_unique<ThreadPool>();
+    return pool;
+}
+} // namespace
+
+ThreadPool& shared_pool() {
+    return *shared_slot();
+}
+
+void resize_shared_pool(uint32_t n_threads) {
+    shared_slot() = std::make_unique<ThreadPool>(n_threads);
+}
+
+ThreadPool& pool_for(uint32_t n_threads, std::unique_ptr<ThreadPool>& own) {
+    if (n_threads == 0 || n_threads == shared_pool().size())
+        return shared_pool();
+    own = std::make_unique<ThreadPool>(n_threads);
+    return *own;
+}
+
+} // namespace xyz
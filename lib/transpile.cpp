@@ -11,18 +11,20 @@
 namespace xyz {
 
 QCircuit transpile_clifford_t(const QCircuit& in, double eps) {
-    QCircuit lowered = decompose_circuit(in);
-    QCircuit out(lowered.num_qbits);
-
-    for (const auto& g : lowered.pGates) {
-        if (auto ry = std::dynamic_pointer_cast<RY>(g)) {
-            auto ry_gates = approximate_ry_sk(ry->target, ry->theta, eps);
-            for (const auto& gate : ry_gates) {
-                out.add_gate(gate);
-            }
+    return QCircuit(transpile_clifford_t(in.to_gate_list(), eps));
+}
+
+GateList transpile_clifford_t(const GateList& in, double eps) {
+    GateList lowered = decompose(in);
+    GateList out(lowered.num_qbits);
+    out.ops.reserve(lowered.size());
+
+    for (const auto& op : lowered.ops) {
+        if (op.kind == GateKind::RY) {
+            approximate_ry_sk(op.target(), op.theta, eps, out);
             continue;
         }
-        out.add_gate(g);
+        out.append(lowered, op);
     }
 
     return out;
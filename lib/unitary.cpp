@@ -364,7 +364,7 @@ Word sk_synthesize(const Matrix2x2& U_in, int depth, const std::vector<NetElem>&
 
 } // namespace
 
-std::vector<std::shared_ptr<QGate>> approximate_ry_sk(uint32_t target, double theta, double eps) {
+void approximate_ry_sk(uint32_t target, double theta, double eps, GateList& out) {
     if (!(eps > 0.0) || !std::isfinite(eps))
         throw std::invalid_argument("approximate_ry_sk: eps must be finite and > 0");
     if (!std::isfinite(theta))
@@ -394,18 +394,28 @@ std::vector<std::shared_ptr<QGate>> approximate_ry_sk(uint32_t target, double th
             break;
     }
 
-    std::vector<std::shared_ptr<QGate>> gates;
-    gates.reserve(best_word.size());
-    for (char g : best_word) {
+    /* the word multiplies left to right, so its last letter acts on the state first */
+    out.ops.reserve(out.ops.size() + best_word.size());
+    for (auto it = best_word.rbegin(); it != best_word.rend(); ++it) {
+        char g = *it;
         if (g == 'H')
-            gates.push_back(std::make_shared<H>(target));
+            out.add(GateKind::H, target);
         else if (g == 'T')
-            gates.push_back(std::make_shared<T>(target));
+            out.add(GateKind::T, target);
         else if (g == 't')
-            gates.push_back(std::make_shared<Tdg>(target));
+            out.add(GateKind::Tdg, target);
         else
             throw std::runtime_error("approximate_ry_sk: unknown symbol in synthesized word");
     }
+}
+
+std::vector<std::shared_ptr<QGate>> approximate_ry_sk(uint32_t target, double theta, double eps) {
+    GateList list;
+    approximate_ry_sk(target, theta, eps, list);
+    std::vector<std::shared_ptr<QGate>> gates;
+    gates.reserve(list.size());
+    for (const auto& op : list.ops)
+        gates.push_back(list.to_gate(op));
     return gates;
 }
 
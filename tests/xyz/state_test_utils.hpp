@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <catch.hpp>
 #include <cmath>
+#include <complex>
 #include <cstdint>
 #include <map>
 #include <random>
@@ -58,7 +59,7 @@ inline QRState random_signed_sparse_state(uint32_t n, std::mt19937_64& rng, uint
 
 inline void require_close(const QRState& a, const QRState& b, double eps = 1e-6) {
     REQUIRE(a.n_bits == b.n_bits);
-    std::vector<uint32_t> keys;
+    std::vector<index_t> keys;
     keys.reserve(a.index_to_weight.size() + b.index_to_weight.size());
     for (const auto& [k, _] : a.index_to_weight)
         keys.push_back(k);
@@ -92,4 +93,21 @@ inline void require_close(const QRState& a, const QRState& b, double eps = 1e-6)
         REQUIRE(std::abs(wa - s * wb) <= eps);
     }
 }
+
+/* complex amplitudes carry their phase, so unlike the QRState overload no global sign is allowed */
+inline void require_close(const QState& a, const QState& b, double eps = 1e-6) {
+    REQUIRE(a.n_bits == b.n_bits);
+    a.index_to_weight.for_each([&](index_t index, const std::complex<double>& w) {
+        REQUIRE(std::abs(w - b.index_to_weight.get(index)) <= eps);
+    });
+    b.index_to_weight.for_each([&](index_t index, const std::complex<double>& w) {
+        REQUIRE(std::abs(w - a.index_to_weight.get(index)) <= eps);
+    });
+}
+
+inline QState to_qstate(const QRState& state) {
+    WeightMap<std::complex<double>> weights;
+    state.index_to_weight.for_each([&](index_t index, double weight) { weights.push_back(index, weight); });
+    return QState(weights, state.n_bits);
+}
 } // namespace xyz::testutil
@@ -0,0 +1,87 @@
+#include "qcircuit.hpp"
+#include "state-vector.hpp"
+#include "state_test_utils.hpp"
+
+#include <sstream>
+
+using namespace xyz;
+using namespace xyz::testutil;
+
+static GateList mixed_gate_list(uint32_t n, std::mt19937_64& rng) {
+    std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+    GateList                               list(n);
+    for (uint32_t q = 0; q < n; q++) {
+        uint32_t next = (q + 1) % n, prev = (q + n - 1) % n;
+        list.add(GateKind::RY, q, angle(rng));
+        list.add(GateKind::CX, prev, q % 2, next);
+        list.add(GateKind::H, next);
+        list.add(GateKind::CRY, next, true, q, angle(rng));
+        list.add_ccx(prev, next, q);
+        list.add(GateKind::Z, prev);
+        list.add_mcry({prev, next}, {true, false}, angle(rng), q);
+        list.add_multiplexed(GateKind::MCMY, {next}, {true}, {angle(rng), angle(rng)}, q);
+    }
+    list.add_multiplexed(GateKind::QROM_MCRY, {0}, {true}, {0.4, -1.3}, n - 1, 1e-3);
+    return list;
+}
+
+TEST_CASE("batched simulation matches one state at a time", "[xyz][batch]") {
+    std::mt19937_64 rng(18);
+    for (uint32_t n : {3u, 6u, 14u}) {
+        GateList list = mixed_gate_list(n, rng);
+        for (std::size_t batch : {1u, 4u, 5u}) {
+            std::vector<QRState> states;
+            for (std::size_t k = 0; k < batch; k++)
+                states.push_back(random_signed_sparse_state(n, rng, 1u << (n - 1)));
+            auto results = simulate_batch(list, states, 4);
+            REQUIRE(results.size() == batch);
+            for (std::size_t k = 0; k < batch; k++) {
+                REQUIRE(results[k].n_bits == n);
+                require_close(simulate(list, states[k], sim_params(false, SimEngine::Dense, 1)), results[k]);
+            }
+        }
+    }
+}
+
+TEST_CASE("batched simulation falls back to sparse states when dense rows do not fit", "[xyz][batch]") {
+    /* 64 sparse states of 28 qubits would need 128 GiB of rows; 38 qubits are past the dense engine */
+    for (auto [n, batch] : {std::pair(28u, 64u), std::pair(dense_engine_max_bits + 8, 2u)}) {
+        GateList list(n);
+        for (uint32_t q = 0; q + 1 < n; q += 5) {
+            list.add(GateKind::RY, q, 0.3 + q);
+            list.add(GateKind::CX, q, true, q + 1);
+        }
+        list.add(GateKind::CRY, n - 1, true, 0, -0.8);
+        std::vector<QRState> states = {ground_rstate(n)};
+        for (uint32_t k = 1; k < batch; k++)
+            states.push_back(random_rstate(n, 16, k));
+        auto results = simulate_batch(list, states, 2);
+        REQUIRE(results.size() == states.size());
+        for (std::size_t k = 0; k < states.size(); k++)
+            require_close(simulate(list, states[k]), results[k]);
+    }
+}
+
+TEST_CASE("batched simulation applies the reverse list", "[xyz][batch]") {
+    std::mt19937_64      rng(7);
+    GateList             list   = mixed_gate_list(5, rng);
+    std::vector<QRState> states = {ground_rstate(5), random_signed_sparse_state(5, rng, 8)};
+    StateBatch           batch(states, 5);
+    ThreadPool           pool(2);
+    for (const auto& op : list.ops)
+        batch.apply(list, op, pool);
+    for (auto it = list.ops.rbegin(); it != list.ops.rend(); ++it)
+        batch.apply(list, *it, pool, true);
+    for (std::size_t k = 0; k < states.size(); k++)
+        require_close(states[k], batch.state(k));
+}
+
+TEST_CASE("batched circuit simulation reads qasm from a stream", "[xyz][batch]") {
+    QCircuit           circuit = prepare_ghz(4);
+    std::istringstream in(circuit.to_qasm2());
+    QCircuit           parsed = read_qasm2(in);
+    REQUIRE(parsed.num_qbits == 4);
+    std::vector<QRState> states(3, ground_rstate(4));
+    for (const auto& result : simulate_circuit(parsed, states))
+        require_close(simulate_circuit(circuit, ground_rstate(4)), result);
+}
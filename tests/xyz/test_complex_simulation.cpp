@@ -0,0 +1,69 @@
+#include "state_test_utils.hpp"
+#include "transpile.hpp"
+
+#include <complex>
+
+using namespace xyz;
+using namespace xyz::testutil;
+
+static std::complex<double> overlap(const QState& a, const QState& b) {
+    std::complex<double> result = 0.0;
+    for (const auto& [index, weight] : a.index_to_weight)
+        result += std::conj(weight) * b.index_to_weight.get(index);
+    return result;
+}
+
+TEST_CASE("complex simulation handles the phase gates", "[xyz][complex]") {
+    QCircuit circuit(1);
+    circuit.add_gate(make_gate<H>(0));
+    circuit.add_gate(make_gate<T>(0));
+    circuit.add_gate(make_gate<T>(0));
+    QState s_state = simulate_circuit(circuit, ground_state(1));
+    REQUIRE(std::abs(s_state.index_to_weight.get(1) - std::complex<double>(0.0, constants::sqrt2_inv)) < 1e-12);
+
+    circuit.add_gate(make_gate<Sdg>(0));
+    circuit.add_gate(make_gate<S>(0));
+    circuit.add_gate(make_gate<Tdg>(0));
+    circuit.add_gate(make_gate<Z>(0));
+    QState state = simulate_circuit(circuit, ground_state(1));
+    REQUIRE(std::abs(state.index_to_weight.get(0) - constants::sqrt2_inv) < 1e-12);
+    REQUIRE(std::abs(state.index_to_weight.get(1) - std::exp(1i * 5.0 * M_PI / 4.0) * constants::sqrt2_inv) < 1e-12);
+
+    QState back = S(0)(Sdg(0)(state));
+    REQUIRE(std::abs(overlap(state, back) - 1.0) < 1e-12);
+    QState inverse = T(0)(state, true);
+    REQUIRE(std::abs(inverse.index_to_weight.get(1) - std::exp(1i * M_PI) * constants::sqrt2_inv) < 1e-12);
+}
+
+TEST_CASE("complex simulation matches the real path on real gates", "[xyz][complex]") {
+    QCircuit circuit(5);
+    circuit.add_gate(make_gate<H>(0));
+    circuit.add_gate(make_gate<RY>(1, 0.3));
+    circuit.add_gate(make_gate<CX>(0, false, 2));
+    circuit.add_gate(make_gate<CRY>(2, true, -1.1, 3));
+    circuit.add_gate(make_gate<CCX>(3, 1, 4));
+    circuit.add_gate(make_gate<MCRY>(std::vector<uint32_t>{0, 3}, std::vector<bool>{true, false}, 0.8, 1));
+    circuit.add_gate(make_gate<MCMY>(std::vector<uint32_t>{1, 2}, std::vector<bool>{true, true},
+                                     std::vector<double>{0.2, -0.4, 0.9, 1.7}, 0));
+    circuit.add_gate(make_gate<X>(3));
+
+    std::mt19937_64 rng(29);
+    for (int it = 0; it < 20; it++) {
+        QRState real    = random_signed_sparse_state(5, rng, 16);
+        QState  complex = simulate_circuit(circuit, to_qstate(real));
+        QRState expect  = simulate_circuit(circuit, real);
+        REQUIRE(std::abs(overlap(to_qstate(expect), complex) - 1.0) < 1e-9);
+    }
+}
+
+TEST_CASE("transpiled Clifford+T circuits are verified in-process", "[xyz][complex]") {
+    QCircuit rotation(1);
+    rotation.add_gate(make_gate<RY>(0, M_PI / 2));
+    QState exact = simulate_circuit(transpile_clifford_t(rotation, 1e-3), ground_state(1));
+    REQUIRE(std::abs(overlap(to_qstate(simulate_circuit(rotation, ground_rstate(1))), exact)) > 1.0 - 1e-9);
+
+    QCircuit circuit = prepare_w(3);
+    QState   target  = to_qstate(simulate_circuit(circuit, ground_rstate(3)));
+    QState   state   = simulate_circuit(transpile_clifford_t(circuit, 1e-3), ground_state(3));
+    REQUIRE(std::abs(overlap(target, state)) > 0.98);
+}
@@ -0,0 +1,106 @@
+#include "state-vector.hpp"
+#include "state_test_utils.hpp"
+
+#include <complex>
+
+using namespace xyz;
+using namespace xyz::testutil;
+
+static GateList random_gate_list(uint32_t n, uint32_t n_gates, std::mt19937_64& rng) {
+    std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+    auto     qubit = [&] { return (uint32_t)(rng() % n); };
+    auto     other = [&](uint32_t q) { return (q + 1 + (uint32_t)(rng() % (n - 1))) % n; };
+    GateList list(n);
+    for (uint32_t i = 0; i < n_gates; i++) {
+        uint32_t t = qubit(), c = other(t);
+        switch (rng() % 9) {
+        case 0:
+            list.add(GateKind::H, t);
+            break;
+        case 1:
+            list.add(GateKind::RY, t, angle(rng));
+            break;
+        case 2:
+            list.add(GateKind::CX, c, rng() % 2, t);
+            break;
+        case 3:
+            list.add(GateKind::CRY, c, rng() % 2, t, angle(rng));
+            break;
+        case 4:
+            list.add(GateKind::X, t);
+            break;
+        case 5:
+            list.add(GateKind::T, t);
+            break;
+        case 6: {
+            uint32_t c2 = other(t);
+            if (c2 == c)
+                list.add(GateKind::Z, t);
+            else
+                list.add_ccx(c, c2, t);
+            break;
+        }
+        case 7:
+            list.add_mcry({c}, {bool(rng() % 2)}, angle(rng), t);
+            break;
+        default:
+            list.add_multiplexed(GateKind::MCMY, {c}, {true}, {angle(rng), angle(rng)}, t);
+        }
+    }
+    return list;
+}
+
+TEST_CASE("dense engine matches the sparse kernels", "[xyz][dense-engine]") {
+    std::mt19937_64  rng(41);
+    const sim_params sparse(false, SimEngine::Sparse), dense(false, SimEngine::Dense, 3);
+    for (uint32_t n : {2u, 3u, 6u}) {
+        for (int it = 0; it < 10; it++) {
+            GateList list = random_gate_list(n, 30, rng);
+            list.add_multiplexed(GateKind::QROM_MCRY, {0}, {true}, {0.4, -1.3}, n - 1, 1e-3);
+            QRState state = random_signed_sparse_state(n, rng, 1u << (n - 1));
+            require_close(simulate(list, state, sparse), simulate(list, state, dense));
+
+            StateVector<double> vector(state.index_to_weight, n);
+            ThreadPool          pool(2);
+            for (const auto& op : list.ops) {
+                QRState expected = QRState(vector.to_weight_map(QRState::eps), n);
+                list.apply(op, expected, true);
+                vector.apply(list, op, pool, true);
+                require_close(expected, QRState(vector.to_weight_map(QRState::eps), n));
+            }
+        }
+    }
+}
+
+TEST_CASE("dense engine splits wide states across threads", "[xyz][dense-engine]") {
+    std::mt19937_64 rng(5);
+    GateList        list = random_gate_list(16, 80, rng);
+    for (uint32_t q = 0; q < 16; q++)
+        list.add(GateKind::H, q);
+    sim_stats stats;
+    QRState   ground   = ground_rstate(16);
+    QRState   expected = simulate(list, ground, sim_params(false, SimEngine::Sparse), &stats);
+    REQUIRE(stats.engine == SimEngine::Sparse);
+    /* the sparse path drops amplitudes below eps after every gate, the dense one only at the end */
+    require_close(expected, simulate(list, ground, sim_params(false, SimEngine::Dense, 4), &stats), 1e-5);
+    REQUIRE(stats.engine == SimEngine::Dense);
+    require_close(expected, simulate(list, ground, sim_params(false, SimEngine::Dense, 1)), 1e-5);
+
+    QState complex_ground = ground_state(16);
+    require_close(simulate(list, complex_ground, sim_params(false, SimEngine::Sparse)),
+                  simulate(list, complex_ground, sim_params(true, SimEngine::Dense, 4)), 1e-5);
+
+    /* Auto is the default and keeps narrow or mostly classical circuits on the sparse path */
+    const sim_params automatic;
+    REQUIRE(automatic.engine == SimEngine::Auto);
+    require_close(expected, simulate(list, ground, automatic, &stats), 1e-5);
+    REQUIRE(stats.engine == SimEngine::Dense);
+    require_close(expected, simulate_circuit(QCircuit(list), ground), 1e-5);
+    GateList classical(16);
+    for (uint32_t q = 0; q < 16; q++)
+        classical.add(GateKind::X, q);
+    simulate(classical, ground, automatic, &stats);
+    REQUIRE(stats.engine == SimEngine::Sparse);
+    simulate(random_gate_list(6, 80, rng), ground_rstate(6), automatic, &stats);
+    REQUIRE(stats.engine == SimEngine::Sparse);
+}
@@ -0,0 +1,110 @@
+#include "state_test_utils.hpp"
+#include "transpile.hpp"
+
+using namespace xyz;
+using namespace xyz::testutil;
+
+static QCircuit mixed_circuit() {
+    QCircuit circuit(6);
+    circuit.add_gate(make_gate<H>(0));
+    circuit.add_gate(make_gate<RY>(1, 0.3));
+    circuit.add_gate(make_gate<CX>(0, false, 2));
+    circuit.add_gate(make_gate<CRY>(2, true, -1.1, 3));
+    circuit.add_gate(make_gate<CRY>(1, false, 0.6, 4));
+    circuit.add_gate(make_gate<CCX>(3, 4, 5));
+    circuit.add_gate(make_gate<Z>(5));
+    circuit.add_gate(make_gate<MCRY>(std::vector<uint32_t>{0, 3}, std::vector<bool>{true, false}, 0.8, 1));
+    circuit.add_gate(make_gate<MCMY>(std::vector<uint32_t>{1, 2}, std::vector<bool>{true, true},
+                                     std::vector<double>{0.2, -0.4, 0.9, 1.7}, 0));
+    circuit.add_gate(make_gate<QROM_MCRY>(std::vector<uint32_t>{4}, std::vector<bool>{true},
+                                          std::vector<double>{0.5, -0.5}, 2, 1e-3));
+    circuit.add_gate(make_gate<X>(3));
+    return circuit;
+}
+
+TEST_CASE("gate list round-trips the class hierarchy", "[xyz][gate-ir]") {
+    QCircuit circuit = mixed_circuit();
+    GateList list    = circuit.to_gate_list();
+    REQUIRE(list.size() == circuit.pGates.size());
+    for (std::size_t i = 0; i < list.size(); i++)
+        REQUIRE(list.to_string(list.ops[i]) == circuit.pGates[i]->to_string());
+
+    QCircuit back(list);
+    REQUIRE(back.num_qbits == circuit.num_qbits);
+    REQUIRE(back.to_gate_list().to_qasm2() == list.to_qasm2());
+    REQUIRE(back.num_cnots() == circuit.num_cnots());
+}
+
+TEST_CASE("gate list simulation matches per-gate apply", "[xyz][gate-ir]") {
+    QCircuit        circuit = mixed_circuit();
+    GateList        list    = circuit.to_gate_list();
+    std::mt19937_64 rng(17);
+    for (int it = 0; it < 30; it++) {
+        QRState state    = random_signed_sparse_state(6, rng, 20);
+        QRState expected = state;
+        for (const auto& gate : circuit.pGates)
+            gate->apply(expected);
+        require_close(expected, simulate(list, state));
+
+        for (const auto& op : list.ops) {
+            QRState a = state, b = state;
+            list.apply(op, a, true);
+            list.to_gate(op)->apply(b, true);
+            require_close(b, a);
+        }
+    }
+}
+
+TEST_CASE("gate list decomposition and transpilation", "[xyz][gate-ir]") {
+    QCircuit circuit = mixed_circuit();
+    GateList lowered = decompose(circuit.to_gate_list());
+    for (const auto& op : lowered.ops) {
+        REQUIRE(op.kind != GateKind::CRY);
+        REQUIRE(!(op.kind == GateKind::CX && !op.phase));
+    }
+    std::mt19937_64 rng(3);
+    QRState         state = random_signed_sparse_state(6, rng, 16);
+    require_close(simulate_circuit(circuit, state), simulate(lowered, state));
+
+    GateList ct = transpile_clifford_t(prepare_w(3).to_gate_list(), 1e-1);
+    for (const auto& op : ct.ops)
+        REQUIRE((op.kind == GateKind::H || op.kind == GateKind::T || op.kind == GateKind::Tdg ||
+                 op.kind == GateKind::CX || op.kind == GateKind::X));
+    REQUIRE(transpile_clifford_t(prepare_w(3), 1e-1).to_qasm2() == ct.to_qasm2());
+}
+
+TEST_CASE("fused simulation matches gate-by-gate simulation", "[xyz][gate-ir]") {
+    GateList rotations(3);
+    for (uint32_t q = 0; q < 3; q++) {
+        rotations.add(GateKind::RY, q, 0.37 + q);
+        rotations.add(GateKind::CX, q, true, (q + 1) % 3);
+        rotations.add(GateKind::RY, q, -1.21 * q + 0.05);
+    }
+    GateList ct = transpile_clifford_t(rotations, 1e-3);
+    ct.add(GateKind::Z, 0);
+    ct.add(GateKind::CX, 0, true, 1);
+    ct.add(GateKind::T, 0);
+    ct.add(GateKind::H, 2);
+    ct.add(GateKind::H, 2);
+
+    sim_stats stats;
+    QRState   expected = simulate(ct, ground_rstate(3));
+    require_close(expected, simulate(ct, ground_rstate(3), sim_params(true), &stats), 1e-5);
+    REQUIRE(stats.num_gates == ct.size());
+    REQUIRE(stats.num_passes < stats.num_gates / 4);
+    REQUIRE(stats.fusion_ratio() > 4.0);
+
+    GateList fused = fuse(ct);
+    REQUIRE(fused.size() == stats.num_passes);
+    uint32_t cx = 0;
+    for (const auto& op : fused.ops)
+        cx += op.kind == GateKind::CX;
+    REQUIRE(cx == 4);
+
+    std::mt19937_64 rng(23);
+    QCircuit        circuit = mixed_circuit();
+    for (int it = 0; it < 20; it++) {
+        QRState state = random_signed_sparse_state(6, rng, 20);
+        require_close(simulate_circuit(circuit, state), simulate_circuit(circuit, state, sim_params(true)));
+    }
+}
@@ -0,0 +1,70 @@
+#include "state_test_utils.hpp"
+#include "thread-pool.hpp"
+
+using namespace xyz;
+using namespace xyz::testutil;
+
+namespace {
+struct ParallelThreshold {
+    std::size_t saved = QRState::parallel_min_size;
+    explicit ParallelThreshold(std::size_t size) { QRState::parallel_min_size = size; }
+    ~ParallelThreshold() { QRState::parallel_min_size = saved; }
+};
+} // namespace
+
+TEST_CASE("parallel sparse kernels match the serial pass", "[xyz][parallel]") {
+    QCircuit circuit(12);
+    for (uint32_t q = 0; q < 12; q++) {
+        circuit.add_gate(make_gate<RY>(q, 0.3 + 0.1 * q));
+        circuit.add_gate(make_gate<CX>(q, q % 2, (q + 5) % 12));
+        circuit.add_gate(make_gate<CRY>((q + 3) % 12, true, -0.7, q));
+        circuit.add_gate(make_gate<X>((q + 7) % 12));
+    }
+    circuit.add_gate(make_gate<CCX>(2, 9, 0));
+    circuit.add_gate(make_gate<MCMY>(std::vector<uint32_t>{4, 11}, std::vector<bool>{true, true},
+                                     std::vector<double>{0.2, -0.4, 0.9, 1.7}, 6));
+
+    std::mt19937_64 rng(11);
+    for (uint32_t support : {40u, 900u, 4096u}) {
+        QRState start = random_signed_sparse_state(12, rng, support);
+        start.update_storage();
+        QRState serial = start, parallel = start;
+        serial.repr();
+        parallel.repr();
+        {
+            ParallelThreshold threshold(std::size_t(1) << 40);
+            for (const auto& gate : circuit.pGates)
+                gate->apply(serial);
+        }
+        {
+            ParallelThreshold threshold(8);
+            resize_shared_pool(4);
+            for (const auto& gate : circuit.pGates) {
+                gate->apply(parallel);
+                REQUIRE(parallel.repr() == parallel.clone().repr());
+            }
+        }
+        resize_shared_pool(0);
+        REQUIRE(serial.repr() == parallel.repr());
+        REQUIRE(serial.is_dense() == parallel.is_dense());
+        require_close(serial, parallel, 0.0);
+    }
+}
+
+TEST_CASE("thread pool rethrows a failed chunk and stays usable", "[xyz][parallel]") {
+    ThreadPool pool(4);
+    for (uint32_t failing : {0u, 1u, 3u}) {
+        std::atomic<uint32_t> ran{0};
+        REQUIRE_THROWS_AS(pool.run(8,
+                                   [&](uint32_t chunk) {
+                                       ran++;
+                                       if (chunk == failing)
+                                           throw std::runtime_error("chunk failed");
+                                   }),
+                          std::runtime_error);
+        REQUIRE(ran >= 1);
+        std::atomic<uint32_t> sum{0};
+        pool.run(8, [&](uint32_t chunk) { sum += chunk; });
+        REQUIRE(sum == 28);
+    }
+}
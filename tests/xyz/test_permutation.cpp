@@ -0,0 +1,85 @@
+#include "permutation.hpp"
+#include "state_test_utils.hpp"
+
+using namespace xyz;
+using namespace xyz::testutil;
+
+static GateList random_permutation_list(uint32_t n, uint32_t n_gates, bool with_ccx, std::mt19937_64& rng) {
+    auto     qubit = [&] { return (uint32_t)(rng() % n); };
+    auto     other = [&](uint32_t q) { return (q + 1 + (uint32_t)(rng() % (n - 1))) % n; };
+    GateList list(n);
+    for (uint32_t i = 0; i < n_gates; i++) {
+        uint32_t t = qubit(), c = other(t), c2 = other(t);
+        switch (rng() % (with_ccx ? 3 : 2)) {
+        case 0:
+            list.add(GateKind::X, t);
+            break;
+        case 1:
+            list.add(GateKind::CX, c, rng() % 2, t);
+            break;
+        default:
+            if (c2 == c)
+                list.add(GateKind::X, t);
+            else
+                list.add_ccx(c, c2, t);
+        }
+    }
+    return list;
+}
+
+TEST_CASE("compiled permutation matches gate by gate relabeling", "[xyz][permutation]") {
+    std::mt19937_64 rng(19);
+    for (uint32_t n : {2u, 5u, 11u}) {
+        for (bool with_ccx : {false, true}) {
+            GateList         list = random_permutation_list(n, 25, with_ccx, rng);
+            IndexPermutation perm(list, 0, list.size());
+            REQUIRE(perm.num_gates() == list.size());
+            if (!with_ccx)
+                REQUIRE(perm.is_affine());
+            for (index_t x = 0; x < (index_t(1) << (n + 1)); x++) {
+                index_t y = x;
+                for (const auto& op : list.ops)
+                    if ((y & op.ctrl_mask) == op.ctrl_value)
+                        y ^= index_t(1) << op.target();
+                REQUIRE(perm(x) == y);
+            }
+        }
+    }
+}
+
+TEST_CASE("simulation relabels permutation runs in one pass", "[xyz][permutation]") {
+    std::mt19937_64 rng(3);
+    for (uint32_t n : {4u, 13u}) {
+        GateList list(n);
+        for (uint32_t q = 0; q < n; q++)
+            list.add(GateKind::RY, q, 0.3 + 0.1 * q);
+        GateList affine = random_permutation_list(n, 40, false, rng);
+        GateList ladder = random_permutation_list(n, 40, true, rng);
+        for (const auto& op : affine.ops)
+            list.append(affine, op);
+        for (const auto& op : ladder.ops)
+            list.append(ladder, op);
+        list.add(GateKind::H, 0);
+        for (const auto& op : ladder.ops)
+            list.append(ladder, op);
+
+        sim_params gate_by_gate(false, SimEngine::Sparse), blocks(false, SimEngine::Sparse);
+        gate_by_gate.permute_run = 0;
+        blocks.permute_run       = 2;
+        sim_stats stats;
+        QRState   state = random_signed_sparse_state(n, rng, 1u << (n - 2));
+        state.repr();
+        QRState expected = simulate(list, state, gate_by_gate, &stats);
+        REQUIRE(stats.num_passes == list.size());
+        QRState result = simulate(list, state, blocks, &stats);
+        require_close(expected, result);
+        REQUIRE(stats.num_passes == n + 3);
+        REQUIRE(result.repr() == QRState(result.index_to_weight, n).repr());
+        /* runs of three are relabeled by default */
+        require_close(expected, simulate(list, state, sim_params(false, SimEngine::Sparse), &stats));
+        REQUIRE(stats.num_passes < list.size());
+
+        QState complex_state = to_qstate(state);
+        require_close(simulate(list, complex_state, gate_by_gate), simulate(list, complex_state, blocks), 1e-9);
+    }
+}
@@ -0,0 +1,82 @@
+#include "phase-polynomial.hpp"
+#include "state-vector.hpp"
+#include "state_test_utils.hpp"
+
+#include <complex>
+
+using namespace xyz;
+using namespace xyz::testutil;
+
+static GateList random_phase_list(uint32_t n, uint32_t n_gates, std::mt19937_64& rng) {
+    const GateKind diagonal[] = {GateKind::T, GateKind::Tdg, GateKind::S, GateKind::Sdg, GateKind::Z};
+    auto           qubit      = [&] { return (uint32_t)(rng() % n); };
+    GateList       list(n);
+    for (uint32_t i = 0; i < n_gates; i++) {
+        uint32_t t = qubit(), c = (t + 1 + (uint32_t)(rng() % (n - 1))) % n;
+        switch (rng() % 4) {
+        case 0:
+            list.add(GateKind::X, t);
+            break;
+        case 1:
+            list.add(GateKind::CX, c, rng() % 2, t);
+            break;
+        default:
+            list.add(diagonal[rng() % 5], t);
+        }
+    }
+    return list;
+}
+
+static QState random_complex_state(uint32_t n, std::mt19937_64& rng, uint32_t max_support) {
+    QRState real = random_signed_sparse_state(n, rng, max_support);
+    QState  state(WeightMap<std::complex<double>>(), n);
+    real.index_to_weight.for_each([&](index_t index, double weight) {
+        state.index_to_weight.push_back(index, weight * std::polar(1.0, 0.1 * (double)index));
+    });
+    return state;
+}
+
+TEST_CASE("phase polynomial matches its gates on basis states", "[xyz][phase-polynomial]") {
+    std::mt19937_64 rng(20);
+    for (uint32_t n : {2u, 4u, 9u}) {
+        GateList        list = random_phase_list(n, 40, rng);
+        PhasePolynomial poly(list, 0, list.size());
+        REQUIRE(poly.num_gates() == list.size());
+        REQUIRE(poly.num_terms() <= (std::size_t(1) << n));
+        for (index_t x = 0; x < (index_t(1) << n); x++) {
+            QState basis(WeightMap<std::complex<double>>(), n);
+            basis.index_to_weight.push_back(x, 1.0);
+            for (const auto& op : list.ops)
+                list.apply(op, basis);
+            const index_t y = poly.permutes() ? poly.permutation()(x) : x;
+            REQUIRE(std::abs(basis.index_to_weight.get(y) - poly(x)) < 1e-12);
+        }
+    }
+}
+
+TEST_CASE("diagonal runs are batched in sparse and dense complex simulation", "[xyz][phase-polynomial]") {
+    std::mt19937_64 rng(8);
+    for (uint32_t n : {3u, 12u}) {
+        GateList list(n);
+        for (int block = 0; block < 4; block++) {
+            GateList run = random_phase_list(n, 30, rng);
+            for (const auto& op : run.ops)
+                list.append(run, op);
+            list.add(GateKind::H, block % n);
+        }
+        sim_params gate_by_gate(false, SimEngine::Sparse), batched(false, SimEngine::Sparse);
+        gate_by_gate.permute_run = 0;
+        gate_by_gate.phase_run   = 0;
+        sim_stats stats;
+        QState    state    = random_complex_state(n, rng, 1u << (n - 1));
+        QState    expected = simulate(list, state, gate_by_gate, &stats);
+        REQUIRE(stats.num_passes == list.size());
+        require_close(expected, simulate(list, state, batched, &stats), 1e-9);
+        REQUIRE(stats.num_passes <= 8);
+
+        sim_params dense(false, SimEngine::Dense, 2);
+        require_close(expected, simulate(list, state, dense), 1e-6);
+        dense.phase_run = 0;
+        require_close(expected, simulate(list, state, dense), 1e-6);
+    }
+}
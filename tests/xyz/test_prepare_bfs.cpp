@@ -0,0 +1,179 @@
+#include "prepare-state.hpp"
+#include "state_test_utils.hpp"
+
+using namespace xyz;
+using namespace xyz::testutil;
+
+TEST_CASE("entangled qubit bound counts qubits that do not factor out", "[xyz][bfs]") {
+    REQUIRE(entangled_qubit_bound(ground_rstate(4)) == 0);
+    REQUIRE(entangled_qubit_bound(simulate_circuit(prepare_ghz(3), ground_rstate(3))) == 2);
+    REQUIRE(entangled_qubit_bound(simulate_circuit(prepare_ghz(4), ground_rstate(4))) == 2);
+    /* |-> (x) |+>: a sign change between branches still factors */
+    REQUIRE(entangled_qubit_bound(make_state(2, {0, 1, 2, 3}, {0.5, -0.5, 0.5, -0.5})) == 0);
+    REQUIRE(entangled_qubit_bound(make_state(3, {0, 3}, {0.6, 0.8})) == 1);
+}
+
+TEST_CASE("A* search finds optimal circuits with fewer expansions", "[xyz][bfs]") {
+    std::mt19937_64 rng(21);
+    bfs_params      dijkstra(12, 1000), astar(12, 1000);
+    dijkstra.heuristic = [](const QRState&) { return 0u; };
+    astar.heuristic    = entangled_qubit_bound;
+    uint64_t expanded_dijkstra = 0, expanded_astar = 0;
+    for (uint32_t n = 2; n <= 4; n++) {
+        for (int it = 0; it < 8; it++) {
+            QRState   target = random_signed_sparse_state(n, rng, 4);
+            QCircuit  a(n), b(n);
+            bfs_stats sa, sb;
+            REQUIRE(prepare_state_bfs(target, a, dijkstra, false, &sa));
+            REQUIRE(prepare_state_bfs(target, b, astar, false, &sb));
+            require_close(target, simulate_circuit(b, ground_rstate(n)));
+            REQUIRE(sa.optimal);
+            REQUIRE(sb.optimal);
+            REQUIRE(sb.cnot_cost == sa.cnot_cost);
+            REQUIRE(sb.cnot_cost == b.num_cnots());
+            REQUIRE(entangled_qubit_bound(target) <= sb.cnot_cost);
+            expanded_dijkstra += sa.num_expanded;
+            expanded_astar += sb.num_expanded;
+        }
+    }
+    REQUIRE(expanded_astar < expanded_dijkstra);
+
+    bfs_stats stats;
+    QCircuit  c(3);
+    REQUIRE(prepare_state_bfs(random_signed_sparse_state(3, rng, 4), c, bfs_params(), false, &stats));
+    REQUIRE_FALSE(stats.optimal);
+}
+
+TEST_CASE("A* search that closes states at max_depth is not reported optimal", "[xyz][bfs]") {
+    const QRState target = random_rstate(3, 4, 6);
+    bfs_params    deep(12, 1000), capped(3, 1000);
+    deep.heuristic = capped.heuristic = entangled_qubit_bound;
+    bfs_stats sd, sc;
+    QCircuit  a(3), b(3);
+    REQUIRE(prepare_state_bfs(target, a, deep, false, &sd));
+    REQUIRE(sd.optimal);
+    /* the solution fits in three moves, but states first reached at the cap were closed on the way */
+    REQUIRE(prepare_state_bfs(target, b, capped, false, &sc));
+    require_close(target, simulate_circuit(b, ground_rstate(3)));
+    REQUIRE(b.pGates.size() <= 3);
+    REQUIRE_FALSE(sc.optimal);
+}
+
+TEST_CASE("perimeter finishes near-product states without expanding them", "[xyz][bfs]") {
+    std::mt19937_64 rng(22);
+    bfs_params      astar(12, 1000), perimeter(12, 1000);
+    astar.heuristic     = entangled_qubit_bound;
+    perimeter.heuristic = entangled_qubit_bound;
+    perimeter.perimeter = true;
+    uint64_t expanded = 0, expanded_perimeter = 0;
+    for (uint32_t n = 2; n <= 4; n++) {
+        for (int it = 0; it < 8; it++) {
+            QRState   target = random_signed_sparse_state(n, rng, 4);
+            QCircuit  a(n), b(n);
+            bfs_stats sa, sb;
+            REQUIRE(prepare_state_bfs(target, a, astar, false, &sa));
+            REQUIRE(prepare_state_bfs(target, b, perimeter, false, &sb));
+            require_close(target, simulate_circuit(b, ground_rstate(n)));
+            REQUIRE(sb.optimal);
+            REQUIRE(sb.cnot_cost == sa.cnot_cost);
+            REQUIRE(sb.cnot_cost == b.num_cnots());
+            expanded += sa.num_expanded;
+            expanded_perimeter += sb.num_expanded;
+        }
+    }
+    REQUIRE(expanded_perimeter < expanded);
+
+    QCircuit  ghz(3);
+    bfs_stats stats;
+    REQUIRE(prepare_state_bfs(simulate_circuit(prepare_ghz(3), ground_rstate(3)), ghz, perimeter, false, &stats));
+    REQUIRE(stats.cnot_cost == 2);
+    REQUIRE(stats.num_expanded <= 2);
+}
+
+TEST_CASE("parallel search returns the serial circuit", "[xyz][bfs]") {
+    std::mt19937_64 rng(23);
+    for (uint32_t n = 2; n <= 4; n++) {
+        for (int it = 0; it < 4; it++) {
+            QRState target = random_signed_sparse_state(n, rng, 4);
+            for (bool astar : {false, true}) {
+                bfs_params serial, parallel;
+                if (astar) {
+                    serial.heuristic   = entangled_qubit_bound;
+                    parallel.heuristic = entangled_qubit_bound;
+                }
+                parallel.n_threads = 4;
+                QCircuit  a(n), b(n);
+                bfs_stats sa, sb;
+                REQUIRE(prepare_state_bfs(target, a, serial, false, &sa) ==
+                        prepare_state_bfs(target, b, parallel, false, &sb));
+                REQUIRE(a.to_qasm2() == b.to_qasm2());
+                REQUIRE(sa.num_expanded == sb.num_expanded);
+                REQUIRE(sa.num_generated == sb.num_generated);
+            }
+        }
+    }
+}
+
+TEST_CASE("canonical state is shared by relabeled, flipped and negated states", "[xyz][bfs]") {
+    std::mt19937_64 rng(24);
+    auto            check = [&](const QRState& state) {
+        const uint32_t n = state.n_bits;
+        state_symmetry to_canonical;
+        const QRState  canonical = canonical_state(state, &to_canonical);
+        require_close(canonical, to_canonical(state));
+        REQUIRE(canonical == to_canonical(state));
+        for (int it = 0; it < 4; it++) {
+            state_symmetry symmetry;
+            for (uint32_t q = 0; q < n; q++)
+                symmetry.qubits.push_back(q);
+            std::shuffle(symmetry.qubits.begin(), symmetry.qubits.end(), rng);
+            symmetry.flips  = (index_t)(rng() % (uint64_t(1) << n));
+            symmetry.negate = rng() % 2;
+            REQUIRE(canonical_state(symmetry(state)) == canonical);
+        }
+    };
+    for (uint32_t n = 2; n <= 5; n++)
+        for (int it = 0; it < 8; it++)
+            check(random_signed_sparse_state(n, rng, 6));
+    check(dicke_state(4, 2));
+    check(dicke_state(5, 2));
+    check(simulate_circuit(prepare_ghz(4), ground_rstate(4)));
+    REQUIRE(canonical_state(make_state(3, {5}, {-1.0})).is_ground());
+}
+
+TEST_CASE("canonical search returns optimal circuits over fewer states", "[xyz][bfs]") {
+    std::mt19937_64 rng(25);
+    bfs_params      astar(12, 1000), canonical(12, 1000);
+    astar.heuristic     = entangled_qubit_bound;
+    canonical.heuristic = entangled_qubit_bound;
+    canonical.canonical = true;
+    std::vector<QRState> targets{dicke_state(4, 2), dicke_state(4, 1), dicke_state(5, 2)};
+    for (uint32_t n = 2; n <= 4; n++)
+        for (int it = 0; it < 6; it++)
+            targets.push_back(random_signed_sparse_state(n, rng, 4));
+    uint64_t expanded = 0, expanded_canonical = 0;
+    for (const auto& target : targets) {
+        const uint32_t n = target.n_bits;
+        QCircuit       a(n), b(n);
+        bfs_stats      sa, sb;
+        REQUIRE(prepare_state_bfs(target, a, astar, false, &sa));
+        REQUIRE(prepare_state_bfs(target, b, canonical, false, &sb));
+        require_close(target, simulate_circuit(b, ground_rstate(n)));
+        REQUIRE(sb.optimal);
+        REQUIRE(sb.cnot_cost == sa.cnot_cost);
+        REQUIRE(sb.cnot_cost == b.num_cnots());
+        expanded += sa.num_expanded;
+        expanded_canonical += sb.num_expanded;
+    }
+    REQUIRE(expanded_canonical < expanded);
+}
+
+TEST_CASE("long searches replay node states past the state cache", "[xyz][bfs]") {
+    const QRState target = random_rstate(4, 6, 7);
+    QCircuit      circuit(4);
+    bfs_stats     stats;
+    REQUIRE(prepare_state_bfs(target, circuit, bfs_params(12, 1000), false, &stats));
+    REQUIRE(stats.num_expanded > 2 * 4096);
+    require_close(target, simulate_circuit(circuit, ground_rstate(4)));
+    REQUIRE(stats.cnot_cost == circuit.num_cnots());
+}
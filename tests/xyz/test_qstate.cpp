@@ -0,0 +1,287 @@
+#include "state_test_utils.hpp"
+
+using namespace xyz;
+using namespace xyz::testutil;
+
+static bool is_sorted_state(const QRState& s) {
+    for (size_t i = 1; i < s.index_to_weight.entries().size(); i++)
+        if (s.index_to_weight.entries()[i - 1].first >= s.index_to_weight.entries()[i].first)
+            return false;
+    return true;
+}
+
+TEST_CASE("flat QRState storage keeps map semantics", "[xyz][qstate]") {
+    std::map<uint32_t, double> m = {{5, 0.6}, {1, 0.8}};
+    QRState                    s(m, 3);
+    REQUIRE(s.index_to_weight.begin()->first == 1);
+    REQUIRE(s.index_to_weight.at(5) == 0.6);
+    REQUIRE(s.index_to_weight.find(2) == s.index_to_weight.end());
+    s.index_to_weight[3] = 0.0;
+    REQUIRE(s.cardinality() == 3);
+    REQUIRE(is_sorted_state(s));
+    REQUIRE(s.index_to_weight.to_map().size() == 3);
+}
+
+TEST_CASE("gate kernels keep amplitudes sorted", "[xyz][qstate]") {
+    std::mt19937_64 rng(7);
+    for (int it = 0; it < 50; it++) {
+        auto    s = random_signed_sparse_state(5, rng, 12);
+        QRState t = s;
+        for (uint32_t q = 0; q < 5; q++) {
+            t = RY(q, 0.3 + q)(t);
+            t = CX((q + 1) % 5, q & 1, q)(t);
+            t = MCRY({(q + 2) % 5, (q + 3) % 5}, {true, false}, -0.7, q)(t);
+            REQUIRE(is_sorted_state(t));
+        }
+        for (int q = 4; q >= 0; q--) {
+            t = MCRY({(q + 2) % 5u, (q + 3) % 5u}, {true, false}, -0.7, q)(t, true);
+            t = CX((q + 1) % 5, q & 1, q)(t, true);
+            t = RY(q, 0.3 + q)(t, true);
+        }
+        require_close(s, t);
+    }
+}
+
+TEST_CASE("dense QRState mode matches sparse mode", "[xyz][qstate]") {
+    auto saved              = QRState::dense_min_bits;
+    QRState::dense_min_bits = 0;
+    auto sparse_ref         = [&](const QRState& s) { return QRState(s.index_to_weight.to_map(), s.n_bits); };
+    for (uint32_t seed = 1; seed <= 5; seed++) {
+        auto target = random_rstate(6, 48, seed);
+        auto dense  = target.clone();
+        dense.update_storage();
+        REQUIRE(dense.is_dense());
+        REQUIRE(dense == target);
+        REQUIRE(dense.repr() == target.repr());
+
+        QRState a = dense, b = target;
+        b.index_to_weight.make_sparse();
+        QRState::dense_min_bits = 64;
+        for (uint32_t q = 0; q < 6; q++)
+            b = MCRY({(q + 1) % 6}, {true}, 0.4, q)(CX((q + 2) % 6, true, q)(H(q)(b)));
+        QRState::dense_min_bits = 0;
+        for (uint32_t q = 0; q < 6; q++)
+            a = MCRY({(q + 1) % 6}, {true}, 0.4, q)(CX((q + 2) % 6, true, q)(H(q)(a)));
+        require_close(sparse_ref(a), b);
+
+        auto c_dense            = prepare_state_dense(target);
+        QRState::dense_min_bits = 64;
+        auto c_sparse           = prepare_state_dense(target);
+        QRState::dense_min_bits = 0;
+        REQUIRE(c_dense.to_qasm2() == c_sparse.to_qasm2());
+    }
+    QRState::dense_min_bits = saved;
+}
+
+TEST_CASE("const access leaves dense storage dense", "[xyz][qstate]") {
+    auto target = random_rstate(6, 48, 9);
+    auto dense  = target.clone();
+    dense.index_to_weight.make_dense(6);
+    const QRState&            view = dense;
+    std::map<index_t, double> seen;
+    for (const auto& [index, weight] : view.index_to_weight)
+        seen.emplace(index, weight);
+    REQUIRE(seen == target.index_to_weight.to_map());
+    const index_t first = target.index_to_weight.entries().front().first;
+    REQUIRE(view.index_to_weight.find(first)->second == target.index_to_weight.at(first));
+    REQUIRE(view.index_to_weight.at(first) == target.index_to_weight.at(first));
+    REQUIRE(view.index_to_weight.lower_bound(first)->first == first);
+    REQUIRE(dense.is_dense());
+
+    /* erasing through an iterator of a map that was copied since leaves the copy alone */
+    QRState sparse = target.clone();
+    auto    it     = sparse.index_to_weight.begin();
+    QRState copy   = sparse;
+    sparse.index_to_weight.erase(it);
+    REQUIRE(sparse.cardinality() == 47);
+    REQUIRE(copy.cardinality() == 48);
+    REQUIRE(sparse.index_to_weight.find(first) == sparse.index_to_weight.end());
+}
+
+TEST_CASE("QRState supports more than 32 qubits", "[xyz][qstate]") {
+    if (index_bits < 64)
+        return;
+    auto s = random_rstate(48, 16, 3);
+    REQUIRE(s.cardinality() == 16);
+    REQUIRE(s.index_to_weight.entries().back().first >> 32 != 0);
+    QRState t = s;
+    for (uint32_t q = 30; q < 48; q += 3) {
+        t = RY(q, 0.2 * q)(t);
+        t = CX(q + 1, true, q + 2)(t);
+        t = MCRY({q, q + 1}, {true, false}, 0.9, q + 2)(t);
+        REQUIRE(is_sorted_state(t));
+    }
+    for (int q = 45; q >= 30; q -= 3) {
+        t = MCRY({(uint32_t)q, (uint32_t)q + 1}, {true, false}, 0.9, q + 2)(t, true);
+        t = CX(q + 1, true, q + 2)(t, true);
+        t = RY(q, 0.2 * q)(t, true);
+    }
+    require_close(s, t);
+    REQUIRE(s.get_supports().size() > 32);
+}
+
+TEST_CASE("incremental repr matches full rehash", "[xyz][qstate]") {
+    std::mt19937_64 rng(11);
+    auto            fresh = [](const QRState& s) { return QRState(s.index_to_weight, s.n_bits).repr(); };
+    for (uint32_t min_bits : {64u, 0u}) {
+        auto saved              = QRState::dense_min_bits;
+        QRState::dense_min_bits = min_bits;
+        for (int it = 0; it < 30; it++) {
+            QRState t = random_signed_sparse_state(5, rng, 20);
+            t.update_storage();
+            (void)t.repr();
+            for (uint32_t q = 0; q < 5; q++) {
+                t = RY(q, 0.5 + q)(t);
+                REQUIRE(t.repr() == fresh(t));
+                t = CX((q + 1) % 5, q & 1, q)(t);
+                REQUIRE(t.repr() == fresh(t));
+                t = CCX((q + 1) % 5, (q + 2) % 5, q)(t);
+                REQUIRE(t.repr() == fresh(t));
+                t = CRY((q + 3) % 5, true, M_PI / 2, q)(t);
+                REQUIRE(t.repr() == fresh(t));
+                t = MCRY({(q + 2) % 5, (q + 4) % 5}, {false, true}, 1.1, q)(Z(q)(X(q)(H(q)(t))));
+                REQUIRE(t.repr() == fresh(t));
+            }
+        }
+        QRState::dense_min_bits = saved;
+    }
+}
+
+TEST_CASE("arena scope owns state storage but not gates", "[xyz][qstate]") {
+    auto*    heap   = state_resource();
+    auto     target = random_rstate(4, 6, 9);
+    QCircuit c(4);
+    {
+        ArenaScope arena;
+        REQUIRE(state_resource() != heap);
+        QRState s = random_rstate(4, 6, 9);
+        REQUIRE(s.index_to_weight.entries().get_allocator().resource() == state_resource());
+        c = prepare_state_auto(s);
+    }
+    REQUIRE(state_resource() == heap);
+    require_close(target, simulate_circuit(c, ground_rstate(4), false));
+}
+
+TEST_CASE("qubit signatures cover more than 64 amplitudes", "[xyz][qstate]") {
+    auto s          = random_rstate(10, 300, 4);
+    auto signatures = s.get_qubit_signatures();
+    auto const1     = s.get_const1_signature();
+    REQUIRE(signatures.size() == 10);
+    REQUIRE(const1.words.size() == 5);
+    uint32_t i = 0;
+    for (const auto& [index, weight] : s.index_to_weight) {
+        for (uint32_t q = 0; q < 10; q++)
+            REQUIRE(((signatures[q].words[i / 64] >> (i % 64)) & 1) == ((index >> q) & 1));
+        REQUIRE(((const1.words[i / 64] >> (i % 64)) & 1) == 1);
+        i++;
+    }
+    REQUIRE((const1.words.back() >> (300 % 64)) == 0);
+
+    auto                      base = random_rstate(8, 150, 6);
+    std::map<index_t, double> m;
+    for (const auto& [index, weight] : base.index_to_weight)
+        m[index | (((index >> 2) & 1) << 8) | (index_t(1) << 9)] = weight;
+    auto reduced = support_reduction(QRState(m, 10)).state;
+    for (uint32_t q : reduced.get_supports())
+        REQUIRE(q < 8);
+}
+
+TEST_CASE("QRState copies share storage until written", "[xyz][qstate]") {
+    auto    s = random_rstate(5, 10, 2);
+    QRState t = s;
+    QRState u = s.clone();
+    REQUIRE(t.index_to_weight.shares_storage(s.index_to_weight));
+    REQUIRE(u.index_to_weight.shares_storage(s.index_to_weight));
+    auto first               = s.index_to_weight.entries()[0].first;
+    t.index_to_weight[first] = 0.25;
+    REQUIRE(!t.index_to_weight.shares_storage(s.index_to_weight));
+    REQUIRE(s.index_to_weight.at(first) != 0.25);
+    REQUIRE(u.index_to_weight.at(first) == s.index_to_weight.at(first));
+    QRState v = X(0)(u);
+    REQUIRE(!v.index_to_weight.shares_storage(u.index_to_weight));
+    REQUIRE(u == s);
+}
+
+TEST_CASE("in-place apply matches out-of-place gates", "[xyz][qstate]") {
+    std::vector<std::shared_ptr<QGate>> gates = {
+        std::make_shared<X>(1),
+        std::make_shared<CX>(0, false, 3),
+        std::make_shared<CCX>(1, 2, 4),
+        std::make_shared<RY>(5, 0.7),
+        std::make_shared<H>(2),
+        std::make_shared<Z>(0),
+        std::make_shared<CRY>(4, true, 1.3, 0),
+        std::make_shared<MCRY>(std::vector<uint32_t>{1, 5}, std::vector<bool>{false, true}, -0.4, 3),
+        std::make_shared<MCMY>(std::vector<uint32_t>{0, 2}, std::vector<bool>{true, true},
+                               std::vector<double>{0.1, 0.2, 0.3, 0.4}, 4),
+    };
+    std::mt19937_64 rng(5);
+    for (int it = 0; it < 40; it++) {
+        QRState t = random_signed_sparse_state(6, rng, 24);
+        (void)t.repr();
+        for (const auto& gate : gates)
+            for (bool reverse : {false, true}) {
+                QRState expected = (*gate)(t, reverse);
+                gate->apply(t, reverse);
+                require_close(expected, t);
+                REQUIRE(is_sorted_state(t));
+                REQUIRE(t.repr() == QRState(t.index_to_weight, t.n_bits).repr());
+            }
+    }
+
+    auto        big  = random_rstate(16, 500, 8);
+    QRState     copy = big;
+    const auto* data = big.index_to_weight.entries().data();
+    CX(3, true, 9).apply(big);
+    REQUIRE(!big.index_to_weight.shares_storage(copy.index_to_weight));
+    data = big.index_to_weight.entries().data();
+    CX(12, false, 2).apply(big);
+    X(7).apply(big);
+    REQUIRE(big.index_to_weight.entries().data() == data);
+    REQUIRE(is_sorted_state(big));
+    require_close(X(7)(CX(12, false, 2)(CX(3, true, 9)(copy))), big);
+}
+
+TEST_CASE("compiled control masks select the same amplitudes", "[xyz][qstate]") {
+    MCRY mcry({0, 3, 6}, {true, false, true}, 0.9, 2);
+    REQUIRE(mcry.ctrl_mask == ((index_t(1) << 0) | (index_t(1) << 3) | (index_t(1) << 6)));
+    REQUIRE(mcry.ctrl_value == ((index_t(1) << 0) | (index_t(1) << 6)));
+    CX cx(5, false, 1);
+    REQUIRE(cx.is_active(0));
+    REQUIRE(!cx.is_active(index_t(1) << 5));
+
+    std::vector<double> angles = {0.1, -0.2, 0.3, 0.4, -0.5, 0.6, 0.7, -0.8};
+    MCMY                mcmy({1, 4, 5}, {true, true, true}, angles, 0);
+    std::mt19937_64     rng(11);
+    for (int it = 0; it < 20; it++) {
+        QRState t        = random_signed_sparse_state(7, rng, 40);
+        QRState expected = t;
+        for (uint32_t i = 0; i < angles.size(); i++)
+            MCRY({1, 4, 5}, {(bool)(i & 1), (bool)((i >> 1) & 1), (bool)((i >> 2) & 1)}, angles[i], 0)
+                .apply(expected);
+        require_close(expected, mcmy(t));
+    }
+}
+
+TEST_CASE("multiplexed rotation kernel handles wide and short tables", "[xyz][qstate]") {
+    std::mt19937_64                        rng(13);
+    std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+    std::vector<uint32_t>                  ctrls = {0, 1, 2, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    std::vector<double>                    table(1u << ctrls.size());
+    for (auto& theta : table)
+        theta = angle(rng);
+    QROM_MCRY qrom(ctrls, std::vector<bool>(ctrls.size(), true), table, 3, 1e-3);
+    QRState   t        = random_rstate(13, 300, 21);
+    QRState   expected = t;
+    for (uint32_t i = 0; i < table.size(); i++) {
+        std::vector<bool> phases(ctrls.size());
+        for (uint32_t j = 0; j < ctrls.size(); j++)
+            phases[j] = (i >> j) & 1u;
+        MCRY(ctrls, phases, table[i], 3).apply(expected, true);
+    }
+    require_close(expected, qrom(t, true));
+
+    MCMY short_table({1, 2}, {true, true}, {0.5, -0.25}, 0);
+    QRState s = random_rstate(3, 8, 4);
+    require_close(MCRY({1, 2}, {true, false}, -0.25, 0)(MCRY({1, 2}, {false, false}, 0.5, 0)(s)), short_table(s));
+}
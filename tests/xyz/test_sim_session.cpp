@@ -0,0 +1,49 @@
+#include "sim-session.hpp"
+#include "state_test_utils.hpp"
+
+using namespace xyz;
+using namespace xyz::testutil;
+
+static GateList rotation_layers(uint32_t n, uint32_t n_layers, double shift = 0.0) {
+    GateList list(n);
+    for (uint32_t layer = 0; layer < n_layers; layer++)
+        for (uint32_t q = 0; q < n; q++) {
+            list.add(GateKind::RY, q, 0.1 * (layer + 1) + 0.3 * q + shift);
+            list.add(GateKind::CX, q, layer % 2, (q + 1) % n);
+        }
+    return list;
+}
+
+TEST_CASE("simulation session resumes from the last checkpoint before an edit", "[xyz][session]") {
+    GateList   list = rotation_layers(5, 10);
+    QRState    ground = ground_rstate(5);
+    SimSession session(ground, 10);
+    REQUIRE(list.size() == 100);
+
+    require_close(simulate(list, ground), session.run(list));
+    REQUIRE(session.last_resumed() == 0);
+    REQUIRE(session.last_applied() == 100);
+    REQUIRE(session.num_checkpoints() == 10);
+
+    require_close(simulate(list, ground), session.run(list));
+    REQUIRE(session.last_applied() == 0);
+
+    list.ops[73].theta += 0.25;
+    list.ops[73].coef = {std::cos(list.ops[73].theta / 2), std::sin(list.ops[73].theta / 2),
+                         -std::sin(list.ops[73].theta / 2), std::cos(list.ops[73].theta / 2)};
+    require_close(simulate(list, ground), session.run(list));
+    REQUIRE(session.last_resumed() == 70);
+    REQUIRE(session.last_applied() == 30);
+
+    list.add(GateKind::H, 2);
+    list.add(GateKind::Z, 0);
+    require_close(simulate(list, ground), session.run(list));
+    REQUIRE(session.last_resumed() == 100);
+    REQUIRE(session.last_applied() == 2);
+
+    GateList other = rotation_layers(5, 10, 0.5);
+    require_close(simulate(other, ground), session.run(other));
+    REQUIRE(session.last_resumed() == 0);
+    require_close(simulate(list, ground), session.run(list));
+    REQUIRE(session.last_resumed() == 0);
+}
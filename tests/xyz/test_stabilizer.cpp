@@ -0,0 +1,73 @@
+#include "stabilizer.hpp"
+#include "state_test_utils.hpp"
+#include "transpile.hpp"
+
+#include <complex>
+
+using namespace xyz;
+using namespace xyz::testutil;
+
+static GateList random_clifford_t(uint32_t n, uint32_t n_gates, std::mt19937_64& rng) {
+    const GateKind single[] = {GateKind::H, GateKind::S, GateKind::Sdg, GateKind::T,
+                               GateKind::Tdg, GateKind::X, GateKind::Z};
+    GateList       list(n);
+    for (uint32_t i = 0; i < n_gates; i++) {
+        uint32_t t = rng() % n, c = (t + 1 + rng() % (n - 1)) % n, c2 = (c + 1 + rng() % (n - 1)) % n;
+        switch (rng() % 4) {
+        case 0:
+            list.add(GateKind::CX, c, rng() % 2, t);
+            break;
+        case 1:
+            if (c2 != t && i % 5 == 0) {
+                list.add_ccx(c, c2, t);
+                break;
+            }
+            [[fallthrough]];
+        default:
+            list.add(single[rng() % 7], t);
+        }
+    }
+    return list;
+}
+
+TEST_CASE("CH-form amplitudes match the complex simulator", "[xyz][stabilizer]") {
+    std::mt19937_64 rng(7);
+    for (uint32_t n : {1u, 2u, 4u}) {
+        for (int it = 0; it < 20; it++) {
+            GateList             list = random_clifford_t(std::max(n, 2u), 12, rng);
+            QState               expected = simulate(list, ground_state(list.num_qbits));
+            std::vector<index_t> xs;
+            for (index_t x = 0; x < (index_t(1) << list.num_qbits); x++)
+                xs.push_back(x);
+            std::vector<std::complex<double>> amplitudes = stabilizer_amplitudes(list, xs);
+            for (index_t x : xs)
+                REQUIRE(std::abs(amplitudes[(std::size_t)x] - expected.index_to_weight.get(x)) < 1e-9);
+        }
+    }
+}
+
+TEST_CASE("stabilizer overlap checks transpiled states", "[xyz][stabilizer]") {
+    GateList ct = transpile_clifford_t(prepare_w(3).to_gate_list(), 1e-3);
+    QRState  w  = normalize(simulate_circuit(prepare_w(3), ground_rstate(3)));
+    QState   state = simulate(ct, ground_state(3));
+    std::complex<double> expected = 0.0;
+    w.index_to_weight.for_each([&](index_t x, double weight) { expected += weight * state.index_to_weight.get(x); });
+    REQUIRE(std::abs(stabilizer_overlap(ct, w) - expected) < 1e-9);
+
+    /* a 60-qubit GHZ state with T-phases on both branches stays out of reach of the dense engines */
+    GateList ghz(60);
+    ghz.add(GateKind::H, 0);
+    for (uint32_t q = 1; q < 60; q++)
+        ghz.add(GateKind::CX, q - 1, true, q);
+    for (uint32_t q = 0; q < 4; q++)
+        ghz.add(GateKind::T, q);
+    REQUIRE(t_count(ghz) == 4);
+    auto amps = stabilizer_amplitudes(ghz, {index_t(0), index_mask(60), index_t(1)});
+    REQUIRE(std::abs(amps[0] - constants::sqrt2_inv) < 1e-9);
+    REQUIRE(std::abs(amps[1] + constants::sqrt2_inv) < 1e-9);
+    REQUIRE(std::abs(amps[2]) < 1e-9);
+
+    auto sampled = stabilizer_amplitudes(ghz, {index_t(0), index_mask(60)}, stabilizer_params(20000, 3));
+    REQUIRE(std::abs(sampled[0] - constants::sqrt2_inv) < 0.05);
+    REQUIRE(std::abs(sampled[1] + constants::sqrt2_inv) < 0.05);
+}
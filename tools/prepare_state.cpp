@@ -20,23 +20,35 @@ struct Counts {
     uint64_t z   = 0;
 };
 
-Counts count_gates(const QCircuit& c) {
+Counts count_gates(const GateList& c) {
     Counts out;
-    for (const auto& g : c.pGates) {
-        if (std::dynamic_pointer_cast<CX>(g))
+    for (const auto& op : c.ops) {
+        switch (op.kind) {
+        case GateKind::CX:
             out.cx++;
-        else if (std::dynamic_pointer_cast<Tdg>(g))
+            break;
+        case GateKind::Tdg:
             out.tdg++;
-        else if (std::dynamic_pointer_cast<T>(g))
+            break;
+        case GateKind::T:
             out.t++;
-        else if (std::dynamic_pointer_cast<Sdg>(g))
+            break;
+        case GateKind::Sdg:
             out.sdg++;
-        else if (std::dynamic_pointer_cast<S>(g))
+            break;
+        case GateKind::S:
             out.s++;
-        else if (std::dynamic_pointer_cast<X>(g))
+            break;
+        case GateKind::X:
+        case GateKind::CCX:
             out.x++;
-        else if (std::dynamic_pointer_cast<Z>(g))
+            break;
+        case GateKind::Z:
             out.z++;
+            break;
+        default:
+            break;
+        }
     }
     return out;
 }
@@ -69,12 +81,12 @@ int main(int argc, char** argv) {
 
     auto target = random_rstate(n, c, s);
     auto prep   = use_dense ? prepare_state_dense(target) : prepare_state_auto(target, v);
-    auto prep_d = decompose_circuit(prep);
+    auto prep_d = decompose(prep.to_gate_list());
 
     bool     do_transpile = !opt.exist("no_transpile");
-    QCircuit ct;
+    GateList ct;
     if (do_transpile)
-        ct = transpile_clifford_t(prep, e);
+        ct = transpile_clifford_t(prep_d, e);
 
     auto   prep_counts = count_gates(prep_d);
     Counts ct_counts;
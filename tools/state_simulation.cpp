@@ -4,6 +4,7 @@
 #include <qcircuit.hpp>
 #include <qgate.hpp>
 #include <qstate.hpp>
+#include <thread-pool.hpp>
 
 using namespace xyz;
 using cmdline::parser;
@@ -11,6 +12,11 @@ using cmdline::parser;
 parser CommandLineParser() {
     parser opt;
     opt.add<std::string>("input", 'i', "path to the input QASM2 file", false, "../data/input.qasm");
+    opt.add("fuse", 'f', "fuse single-qubit gate runs before simulating");
+    opt.add("complex", 'c', "simulate complex amplitudes (supports S, Sdg, T and Tdg exactly)");
+    opt.add<std::string>("engine", 'e', "simulation engine", false, "auto",
+                         cmdline::oneof<std::string>("auto", "sparse", "dense"));
+    opt.add<uint32_t>("threads", 't', "worker threads of the dense engine and the sparse kernels (0: all cores)", false, 0);
     return opt;
 }
 
@@ -19,10 +25,34 @@ int main(int argc, char** argv) {
     opt.parse_check(argc, argv);
 
     auto qc = read_qasm2(opt.get<std::string>("input"));
+    if (opt.exist("threads"))
+        resize_shared_pool(opt.get<uint32_t>("threads"));
+
+    std::string engine = opt.get<std::string>("engine");
+    sim_params  params(opt.exist("fuse"),
+                       engine == "dense"    ? SimEngine::Dense
+                        : engine == "sparse" ? SimEngine::Sparse
+                                             : SimEngine::Auto,
+                       opt.get<uint32_t>("threads"));
+
+    if (opt.exist("complex")) {
+        std::cout << "Final State: " << simulate_circuit(qc, ground_state(qc.num_qbits), params) << std::endl;
+        return 0;
+    }
 
     uint32_t n_qbits   = qc.num_qbits;
     QRState  state     = ground_rstate(n_qbits);
-    QRState  new_state = simulate_circuit(qc, state, true);
+    QRState  new_state;
+    if (opt.exist("fuse") || opt.exist("engine") || opt.exist("threads")) {
+        sim_stats stats;
+        new_state = simulate_circuit(qc, state, params, &stats);
+        if (params.fuse)
+            std::cout << "Fused " << stats.num_gates << " gates into " << stats.num_passes
+                      << " passes (ratio: " << stats.fusion_ratio() << ")" << std::endl;
+        std::cout << "Engine: " << (stats.engine == SimEngine::Dense ? "dense" : "sparse") << std::endl;
+    } else {
+        new_state = simulate_circuit(qc, state, true);
+    }
 
     std::cout << "Initial State: " << state << std::endl;
     std::cout << "Final State: " << new_state << std::endl;
@@ -3,6 +3,9 @@
 #include <qcircuit.hpp>
 #include <qgate.hpp>
 #include <qstate.hpp>
+#include <stabilizer.hpp>
+
+#include <iostream>
 
 using cmdline::parser;
 using namespace xyz;
@@ -12,6 +15,8 @@ parser CommandLineParser() {
     opt.add<std::string>("input", 'i', "path to input QASM2", false, "../data/input.qasm");
     opt.add<std::string>("output", 'o', "path to output QASM2", false, "out_ct.qasm");
     opt.add<double>("eps", 'e', "approximation tolerance", false, 1e-3);
+    opt.add("verify", 'v', "report the fidelity of the output with the input state (stabilizer-rank simulation)");
+    opt.add<uint32_t>("samples", 's', "sampled stabilizer terms for --verify (0: exact sum)", false, 0);
     return opt;
 }
 
@@ -20,7 +25,14 @@ int main(int argc, char** argv) {
     opt.parse_check(argc, argv);
 
     auto in  = read_qasm2(opt.get<std::string>("input"));
-    auto out = transpile_clifford_t(in, opt.get<double>("eps"));
+    auto out = transpile_clifford_t(in.to_gate_list(), opt.get<double>("eps"));
     write_qasm2(out, opt.get<std::string>("output"));
+
+    if (opt.exist("verify")) {
+        QRState              target  = simulate_circuit(in, ground_rstate(in.num_qbits));
+        std::complex<double> overlap = stabilizer_overlap(out, target, stabilizer_params(opt.get<uint32_t>("samples")));
+        std::cout << "T-count: " << t_count(out) << std::endl;
+        std::cout << "Fidelity: " << std::norm(overlap) << std::endl;
+    }
     return 0;
 }